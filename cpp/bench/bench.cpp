@@ -0,0 +1,269 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+// Throughput of the main parse and write paths, over a small input, a
+// feature-length one and that concatenated a hundred times.
+//
+// Usage: screenplay_bench [--filter text] [file.fountain]
+//
+// The feature-length input is the given file, or else a generated screenplay
+// of 120 pages at 55 lines a page (see corpus.h). For each path it reports MB/s
+// of the text read or written, lines/s and elements/s of the screenplay, and
+// the peak resident set size while that path ran, which includes the input and
+// its parsed script. --filter only runs the paths with the text in their names.
+//
+// Built with SCREENPLAY_TOOLS_PARSE_STATS, it also shows how often each of the
+// Fountain parser's rules was tried and matched, and the time spent in it.
+
+#include "corpus.h"
+#include "screenplay_tools/fdx/parser.h"
+#include "screenplay_tools/fdx/stream_parser.h"
+#include "screenplay_tools/fdx/writer.h"
+#include "screenplay_tools/fountain/callback_parser.h"
+#include "screenplay_tools/fountain/format_helper.h"
+#include "screenplay_tools/fountain/parser.h"
+#include "screenplay_tools/fountain/writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace ScreenplayTools;
+
+namespace {
+
+std::string loadFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    throw std::runtime_error("Failed to open file: " + path);
+  std::ostringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+// The first part of text, cut at a line end, with about a tenth of its lines
+std::string smallPart(const std::string &text) {
+  size_t lines = std::count(text.begin(), text.end(), '\n') / 10;
+  size_t end = 0;
+  while (lines-- > 0 && end != std::string::npos)
+    end = text.find('\n', end + 1);
+  return text.substr(0, end);
+}
+
+#ifdef __linux__
+// Linux lets the peak be reset, so each path gets its own
+void resetPeakRss() {
+  if (FILE *file = std::fopen("/proc/self/clear_refs", "w")) {
+    std::fputs("5", file);
+    std::fclose(file);
+  }
+}
+
+size_t peakRssKb() {
+  size_t kb = 0;
+  if (FILE *file = std::fopen("/proc/self/status", "r")) {
+    char line[256];
+    while (std::fgets(line, sizeof(line), file)) {
+      if (std::sscanf(line, "VmHWM: %zu kB", &kb) == 1)
+        break;
+    }
+    std::fclose(file);
+  }
+  return kb;
+}
+#elif !defined(_WIN32)
+// Elsewhere it's the peak for the process so far
+void resetPeakRss() {}
+
+size_t peakRssKb() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+#else
+void resetPeakRss() {}
+size_t peakRssKb() { return 0; }
+#endif
+
+struct Input {
+  std::string name;
+  std::string fountain;
+  std::string fdx;
+  Script script;
+  size_t lines = 0;
+  size_t elements = 0;
+};
+
+Input makeInput(std::string name, std::string fountain) {
+  Input input;
+  input.name = std::move(name);
+  input.fountain = std::move(fountain);
+
+  Fountain::Parser parser;
+  parser.addText(input.fountain);
+  input.script = std::move(*parser.getScript());
+  input.fdx = FDX::Writer().Write(input.script);
+  input.lines = std::count(input.fountain.begin(), input.fountain.end(), '\n');
+  input.elements = input.script.getElements().size();
+  return input;
+}
+
+// Paths whose names don't contain this are skipped
+std::string filter;
+
+// Runs body until at least half a second has gone by, and reports the mean
+// time per run. bytes is how much text a run reads or writes.
+void run(const Input &input, const char *path, size_t bytes,
+         const std::function<void()> &body) {
+  using Clock = std::chrono::steady_clock;
+
+  if (std::string_view(path).find(filter) == std::string_view::npos)
+    return;
+
+  resetPeakRss();
+  size_t runs = 0;
+  const auto start = Clock::now();
+  std::chrono::duration<double> elapsed{};
+  do {
+    body();
+    runs++;
+    elapsed = Clock::now() - start;
+  } while (elapsed.count() < 0.5);
+  const size_t peak = peakRssKb();
+
+  const double seconds = elapsed.count() / runs;
+  std::printf("%-8s %-28s %9.2f %12.0f %12.0f %9.1f\n", input.name.c_str(),
+              path, bytes / seconds / 1e6, input.lines / seconds,
+              input.elements / seconds, peak / 1024.0);
+  std::fflush(stdout);
+}
+
+#ifdef SCREENPLAY_TOOLS_PARSE_STATS
+void printParseStats(const Input &input) {
+  Fountain::Parser parser;
+  parser.addText(input.fountain);
+  const Fountain::ParseStats &stats = parser.stats;
+
+  std::printf("%-8s %-28s %9s %12s %12s\n", input.name.c_str(), "rule",
+              "ms", "attempts", "hits");
+  for (size_t i = 0; i < stats.rules.size(); i++) {
+    const auto &rule = stats.rules[i];
+    std::printf("%-8s %-28s %9.2f %12llu %12llu\n", input.name.c_str(),
+                Fountain::getParseRuleName(static_cast<Fountain::ParseRule>(i)),
+                rule.nanoseconds / 1e6,
+                static_cast<unsigned long long>(rule.attempts),
+                static_cast<unsigned long long>(rule.hits));
+  }
+  std::printf("%-8s transitions %llu (%llu as action), characters %llu (%llu "
+              "as action)\n",
+              input.name.c_str(),
+              static_cast<unsigned long long>(stats.transitions),
+              static_cast<unsigned long long>(stats.transitionsAsAction),
+              static_cast<unsigned long long>(stats.characters),
+              static_cast<unsigned long long>(stats.charactersAsAction));
+  std::printf("%-8s merges: %llu action, %llu padding, %llu dialogue\n",
+              input.name.c_str(),
+              static_cast<unsigned long long>(stats.actionMerges),
+              static_cast<unsigned long long>(stats.paddingMerges),
+              static_cast<unsigned long long>(stats.dialogueMerges));
+}
+#endif
+
+void benchmark(const Input &input) {
+  std::printf("%-8s %.2f MB, %zu lines, %zu elements\n", input.name.c_str(),
+              input.fountain.size() / 1e6, input.lines, input.elements);
+
+  run(input, "Fountain::Parser::addText", input.fountain.size(), [&] {
+    Fountain::Parser parser;
+    parser.addText(input.fountain);
+  });
+
+  run(input, "CallbackParser", input.fountain.size(), [&] {
+    size_t events = 0;
+    Fountain::CallbackParser parser;
+    parser.onDialogue = [&](const std::string &, std::optional<std::string>,
+                            std::optional<std::string>, const std::string &,
+                            bool) { events++; };
+    parser.onAction = [&](const std::string &) { events++; };
+    parser.onSceneHeading = [&](const std::string &,
+                                std::optional<std::string>) { events++; };
+    parser.addText(input.fountain);
+  });
+
+  run(input, "Fountain::Writer::write", input.fountain.size(), [&] {
+    Fountain::Writer().write(input.script);
+  });
+
+  run(input, "FDX::Parser::Parse", input.fdx.size(),
+      [&] { FDX::Parser().Parse(input.fdx); });
+
+  run(input, "FDX::StreamParser", input.fdx.size(), [&] {
+    size_t events = 0;
+    FDX::StreamParser parser;
+    parser.onElement = [&](const Element &) { events++; };
+    const std::string_view fdx = input.fdx;
+    for (size_t pos = 0; pos < fdx.size(); pos += 64 * 1024)
+      parser.AddChunk(fdx.substr(pos, 64 * 1024));
+    parser.Finish();
+  });
+
+  run(input, "FDX::Writer::Write", input.fdx.size(),
+      [&] { FDX::Writer().Write(input.script); });
+
+  run(input, "FormatHelper::FountainToHtml", input.fountain.size(), [&] {
+    Fountain::FormatHelper::FountainToHtml(input.fountain);
+  });
+
+#ifdef SCREENPLAY_TOOLS_PARSE_STATS
+  printParseStats(input);
+#endif
+  std::printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string path;
+  for (int i = 1; i < argc; i++) {
+    if (std::string_view(argv[i]) == "--filter" && i + 1 < argc)
+      filter = argv[++i];
+    else
+      path = argv[i];
+  }
+
+  try {
+    const std::string feature =
+        path.empty() ? generateCorpus({}).fountain : loadFile(path);
+
+    std::printf("%-8s %-28s %9s %12s %12s %9s\n", "input", "path", "MB/s",
+                "lines/s", "elements/s", "peak MB");
+
+    // Each input is made and freed in turn, so the peaks aren't all taken up
+    // by the largest one
+    benchmark(makeInput("small", smallPart(feature)));
+    benchmark(makeInput("feature", feature));
+
+    std::string hundred;
+    hundred.reserve((feature.size() + 1) * 100);
+    for (int i = 0; i < 100; i++)
+      hundred += feature + "\n";
+    benchmark(makeInput("100x", std::move(hundred)));
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,310 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "corpus.h"
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+
+namespace ScreenplayTools {
+
+namespace {
+
+// SplitMix64. The standard library's engines are portable but its
+// distributions aren't, so numbers are drawn from this directly.
+class Random {
+public:
+  explicit Random(uint64_t seed) : _state(seed) {}
+
+  uint64_t next() {
+    uint64_t z = (_state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  size_t below(size_t n) { return next() % n; }
+  bool chance(unsigned percent) { return below(100) < percent; }
+
+  template <size_t N> const char *pick(const char *const (&items)[N]) {
+    return items[below(N)];
+  }
+
+private:
+  uint64_t _state;
+};
+
+// Nothing here can be mistaken for Fountain syntax or needs escaping in XML
+const char *const words[] = {
+    "the",    "door",    "opens",  "slowly",  "she",      "looks",
+    "at",     "window",  "rain",   "falls",   "outside",  "a",
+    "phone",  "rings",   "he",     "waits",   "for",      "answer",
+    "light",  "across",  "room",   "they",    "move",     "toward",
+    "car",    "quietly", "again",  "never",   "paper",    "coffee",
+    "cold",   "street",  "empty",  "old",     "letter",   "keys",
+    "table",  "stairs",  "night",  "crowd",   "silence",  "train",
+    "café",   "naïve",   "façade", "jalapeño", "déjà",    "vu"};
+
+const char *const names[] = {"ALICE", "BOB",     "CAROL", "DAVE",
+                             "EVE",   "FRANK",   "GRACE", "HEIDI",
+                             "IVAN",  "MALLORY", "OSCAR", "PEGGY",
+                             "TRENT", "VICTOR",  "WENDY"};
+
+const char *const extensions[] = {"V.O.", "O.S.", "O.C."};
+
+const char *const places[] = {"INT.", "EXT.", "INT./EXT."};
+
+const char *const locations[] = {
+    "KITCHEN",   "ROOFTOP",  "POLICE STATION", "DINER",   "CAR",
+    "HOSPITAL",  "BEACH",    "OFFICE",         "SUBWAY",  "MOTEL ROOM",
+    "WAREHOUSE", "BACKYARD", "LIBRARY",        "HALLWAY", "CHURCH"};
+
+const char *const times[] = {"DAY", "NIGHT", "MORNING", "LATER",
+                             "CONTINUOUS"};
+
+const char *const transitions[] = {"CUT TO:", "DISSOLVE TO:", "SMASH CUT TO:",
+                                   "MATCH CUT TO:"};
+
+const char *const parentheticals[] = {"beat", "quietly", "laughing",
+                                      "to herself", "off his look"};
+
+const char *const tags[] = {"blocking", "props", "vfx", "sound"};
+
+class Generator {
+public:
+  explicit Generator(const CorpusOptions &options)
+      : _options(options), _random(options.seed) {}
+
+  Corpus run() {
+    _corpus.fdx = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                  "<FinalDraft DocumentType=\"Script\" Template=\"No\" "
+                  "Version=\"1\">\n"
+                  "  <Content>\n";
+
+    if (_options.titlePage)
+      _titlePage();
+    while (_corpus.lines < _options.lines)
+      _scene();
+
+    _corpus.fdx += "  </Content>\n"
+                   "</FinalDraft>\n";
+    return std::move(_corpus);
+  }
+
+private:
+  const CorpusOptions &_options;
+  Random _random;
+  Corpus _corpus;
+
+  // Who spoke last in the current scene
+  const char *_lastSpeaker = nullptr;
+
+  void _line(std::string_view text) {
+    _corpus.fountain += text;
+    _corpus.fountain += '\n';
+    _corpus.lines++;
+  }
+
+  void _paragraph(const char *type, std::string_view text) {
+    _corpus.fdx += "    <Paragraph Type=\"";
+    _corpus.fdx += type;
+    _corpus.fdx += "\">\n      <Text>";
+    _corpus.fdx += text;
+    _corpus.fdx += "</Text>\n    </Paragraph>\n";
+  }
+
+  // Mixed case, so never taken for a cue or transition
+  std::string _sentence() {
+    std::string sentence = _random.pick(words);
+    sentence[0] = static_cast<char>(std::toupper(sentence[0]));
+    for (size_t count = 2 + _random.below(10); count > 0; count--) {
+      sentence += ' ';
+      sentence += _random.pick(words);
+    }
+    sentence += _random.chance(20) ? '?' : '.';
+    return sentence;
+  }
+
+  std::string _sentences() {
+    std::string text = _sentence();
+    for (size_t count = _random.below(3); count > 0; count--)
+      text += ' ' + _sentence();
+    return text;
+  }
+
+  // Adds a tag to a line of Fountain, if it gets one
+  void _tag(std::string &line) {
+    if (_random.chance(_options.tagChance)) {
+      line += " #";
+      line += _random.pick(tags);
+    }
+  }
+
+  void _titlePage() {
+    _line("Title: Generated Screenplay");
+    _line("Credit: Written by");
+    _line("Author: Corpus Generator");
+    _line("Draft date: 1/1/2024");
+    _line("Contact:");
+    _line("    123 Example Street");
+    _line("    Somewhere");
+    _line("");
+  }
+
+  void _scene() {
+    if (_random.chance(_options.sectionChance)) {
+      _line(std::string(1 + _random.below(3), '#') + " " + _sentence());
+      _line("");
+    }
+    if (_random.chance(_options.pageBreakChance)) {
+      _line("===");
+      _line("");
+    }
+
+    std::string heading = _random.pick(places);
+    heading += ' ';
+    heading += _random.pick(locations);
+    heading += " - ";
+    heading += _random.pick(times);
+    std::string line = heading;
+    if (_random.chance(_options.sceneNumberChance))
+      line += " #" + std::to_string(1 + _random.below(200)) + "#";
+    _line(line);
+    _line("");
+    _paragraph("Scene Heading", heading);
+
+    if (_random.chance(_options.synopsisChance)) {
+      _line("= " + _sentence());
+      _line("");
+    }
+
+    _lastSpeaker = nullptr;
+    bool afterAction = false;
+    for (size_t blocks = 3 + _random.below(8); blocks > 0; blocks--) {
+      // Actions in a row would be merged, so there's never two
+      const unsigned actionWeight = afterAction ? 0 : _options.actionWeight;
+      const size_t total = actionWeight + _options.dialogueWeight +
+                           _options.dualDialogueWeight + _options.lyricsWeight;
+      if (total == 0)
+        break;
+      size_t choice = _random.below(total);
+
+      afterAction = false;
+      if (choice < actionWeight) {
+        _action();
+        afterAction = true;
+      } else if ((choice -= actionWeight) < _options.dialogueWeight) {
+        _dialogue(false);
+      } else if ((choice -= _options.dialogueWeight) <
+                 _options.dualDialogueWeight) {
+        _dialogue(false);
+        _dialogue(true);
+      } else {
+        _line("~" + _sentence());
+        _line("");
+      }
+    }
+
+    if (_random.chance(_options.transitionChance)) {
+      const char *transition = _random.pick(transitions);
+      _line(transition);
+      _line("");
+      _paragraph("Transition", transition);
+    }
+  }
+
+  void _action() {
+    size_t lines = 1 + _random.below(3);
+    if (_random.chance(_options.mergedActionChance))
+      lines = std::max<size_t>(_options.mergedActionLines, 1);
+
+    std::string fdx;
+    for (size_t i = 0; i < lines; i++) {
+      if (i > 0)
+        fdx += '\n';
+
+      std::string line;
+      if (_random.chance(_options.longLineChance)) {
+        do
+          line += _sentence() + ' ';
+        while (line.size() < _options.longLineLength);
+        line.pop_back();
+      } else {
+        line = _sentences();
+      }
+
+      if (_random.chance(_options.noteChance)) {
+        // The note's taken out of the FDX, leaving the space before it
+        fdx += line + ' ';
+        line += " [[" + _sentence() + "]]";
+      } else if (i > 0 && i + 1 < lines &&
+                 _random.chance(_options.boneyardChance)) {
+        // Opens at the end of this line and closes at the start of a later
+        // one, all of which make up one line of the action. Not on the first
+        // line, which the parser would join to any dialogue before it.
+        fdx += line + ' ';
+        _line(line + " /*" + _sentence());
+        for (size_t hidden = _random.below(3); hidden > 0; hidden--)
+          _line(_sentence());
+        line = _sentences();
+        fdx += ' ' + line;
+        line = _sentence() + "*/ " + line;
+        i++;
+      } else {
+        fdx += line;
+      }
+
+      _tag(line);
+      _line(line);
+    }
+    _line("");
+    _paragraph("Action", fdx);
+  }
+
+  void _dialogue(bool dual) {
+    const char *speaker = _random.pick(names);
+    std::string cue = speaker;
+    std::string fdxCue = speaker;
+    if (dual) {
+      cue += " ^";
+    } else if (speaker == _lastSpeaker &&
+               _random.chance(_options.contdChance)) {
+      cue += " (CONT'D)";
+    } else if (_random.chance(_options.extensionChance)) {
+      std::string extension =
+          std::string(" (") + _random.pick(extensions) + ")";
+      cue += extension;
+      fdxCue += extension;
+    }
+    _lastSpeaker = speaker;
+    _line(cue);
+    _paragraph("Character", fdxCue);
+
+    if (_random.chance(_options.parentheticalChance)) {
+      std::string parenthetical =
+          std::string("(") + _random.pick(parentheticals) + ")";
+      _line(parenthetical);
+      _paragraph("Parenthetical", parenthetical);
+    }
+
+    std::string fdx;
+    for (size_t lines = 1 + _random.below(3); lines > 0; lines--) {
+      std::string line = _sentences();
+      fdx += line;
+      if (lines > 1)
+        fdx += '\n';
+      _tag(line);
+      _line(line);
+    }
+    _line("");
+    _paragraph("Dialogue", fdx);
+  }
+};
+
+} // namespace
+
+Corpus generateCorpus(const CorpusOptions &options) {
+  return Generator(options).run();
+}
+
+} // namespace ScreenplayTools
@@ -0,0 +1,63 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ScreenplayTools {
+
+// What goes into a generated screenplay. Chances are percentages.
+struct CorpusOptions {
+  uint64_t seed = 1;
+
+  // Scenes are added until there are at least this many lines of Fountain
+  size_t lines = 120 * 55;
+
+  bool titlePage = true;
+
+  // Relative weights of the blocks that make up a scene after its heading
+  unsigned actionWeight = 40;
+  unsigned dialogueWeight = 45;
+  unsigned dualDialogueWeight = 5;
+  unsigned lyricsWeight = 2;
+
+  unsigned sceneNumberChance = 30;
+  unsigned sectionChance = 10;  // A section before a scene
+  unsigned synopsisChance = 10; // A synopsis after a scene heading
+  unsigned transitionChance = 20;
+  unsigned pageBreakChance = 2;
+  unsigned extensionChance = 10;
+  unsigned contdChance = 50; // A speaker's cue when they spoke last
+  unsigned parentheticalChance = 20;
+  unsigned noteChance = 5;     // A note in an action line
+  unsigned boneyardChance = 3; // A boneyard spanning lines in an action
+  unsigned tagChance = 0;      // A tag on an action or dialogue line
+
+  // Pathological cases: the chance of an action line that's longLineLength
+  // long, and of an action block of mergedActionLines lines.
+  unsigned longLineChance = 0;
+  size_t longLineLength = 64 * 1024;
+  unsigned mergedActionChance = 0;
+  size_t mergedActionLines = 1000;
+};
+
+// A screenplay as Fountain, and the same script as FDX. The FDX has the
+// elements that FDX::Writer writes, as FDX::Writer would write them from the
+// parsed Fountain. Tags are left out of it, so the Fountain should be parsed
+// with useTags when there are any.
+struct Corpus {
+  std::string fountain;
+  std::string fdx;
+  size_t lines = 0;
+};
+
+// The same options always give the same corpus, on any platform.
+Corpus generateCorpus(const CorpusOptions &options);
+
+} // namespace ScreenplayTools
+
+#endif // CORPUS_H
@@ -0,0 +1,116 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+// Writes a generated screenplay as Fountain, and optionally as FDX.
+//
+// Usage: screenplay_corpus [options] [-o file.fountain] [--fdx file.fdx]
+//
+// The Fountain goes to stdout unless -o is given. Options set the fields of
+// CorpusOptions, by their names in corpus.h: --seed 7, --lines 100000,
+// --tagChance 20, --longLineChance 1 and so on, and --no-titlePage.
+
+#include "corpus.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+using namespace ScreenplayTools;
+
+namespace {
+
+bool writeFile(const std::string &path, const std::string &text) {
+  std::ofstream file(path, std::ios::binary);
+  file << text;
+  if (!file) {
+    std::cerr << "Failed to write " << path << "\n";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  CorpusOptions options;
+  std::string fountainPath;
+  std::string fdxPath;
+
+  auto number = [](const char *flag, const char *value, auto &field) {
+    try {
+      field = static_cast<std::remove_reference_t<decltype(field)>>(
+          std::stoull(value));
+      return true;
+    } catch (const std::exception &) {
+      std::cerr << "Bad number for --" << flag << ": " << value << "\n";
+      return false;
+    }
+  };
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--no-titlePage") {
+      options.titlePage = false;
+      continue;
+    }
+    if (!arg.starts_with("-") || i + 1 == argc) {
+      std::cerr << "Unexpected argument: " << arg << "\n";
+      return 1;
+    }
+
+    const char *value = argv[++i];
+    if (arg == "-o") {
+      fountainPath = value;
+      continue;
+    }
+    if (arg == "--fdx") {
+      fdxPath = value;
+      continue;
+    }
+
+    arg.remove_prefix(arg.starts_with("--") ? 2 : 1);
+    bool ok = false;
+#define CORPUS_OPTION(name)                                                    \
+  if (arg == #name)                                                            \
+    ok = number(#name, value, options.name);
+    CORPUS_OPTION(seed)
+    CORPUS_OPTION(lines)
+    CORPUS_OPTION(actionWeight)
+    CORPUS_OPTION(dialogueWeight)
+    CORPUS_OPTION(dualDialogueWeight)
+    CORPUS_OPTION(lyricsWeight)
+    CORPUS_OPTION(sceneNumberChance)
+    CORPUS_OPTION(sectionChance)
+    CORPUS_OPTION(synopsisChance)
+    CORPUS_OPTION(transitionChance)
+    CORPUS_OPTION(pageBreakChance)
+    CORPUS_OPTION(extensionChance)
+    CORPUS_OPTION(contdChance)
+    CORPUS_OPTION(parentheticalChance)
+    CORPUS_OPTION(noteChance)
+    CORPUS_OPTION(boneyardChance)
+    CORPUS_OPTION(tagChance)
+    CORPUS_OPTION(longLineChance)
+    CORPUS_OPTION(longLineLength)
+    CORPUS_OPTION(mergedActionChance)
+    CORPUS_OPTION(mergedActionLines)
+#undef CORPUS_OPTION
+    if (!ok) {
+      std::cerr << "Unknown or bad option: " << argv[i - 1] << "\n";
+      return 1;
+    }
+  }
+
+  const Corpus corpus = generateCorpus(options);
+
+  if (fountainPath.empty())
+    std::fwrite(corpus.fountain.data(), 1, corpus.fountain.size(), stdout);
+  else if (!writeFile(fountainPath, corpus.fountain))
+    return 1;
+
+  if (!fdxPath.empty() && !writeFile(fdxPath, corpus.fdx))
+    return 1;
+  return 0;
+}
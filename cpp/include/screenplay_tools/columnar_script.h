@@ -0,0 +1,120 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#ifndef COLUMNAR_SCRIPT_H
+#define COLUMNAR_SCRIPT_H
+
+#include "screenplay.h"
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ScreenplayTools {
+
+// Compact, read-only copy of a Script's elements laid out as parallel arrays,
+// for scans that filter on element type. Element i has a one-byte type tag,
+// a range of clean text (see Element::getText()) in one shared text blob, a
+// set of flags and, depending on its type, a row in a side table.
+// Dialogue and parentheticals share the side-table row of the character cue
+// they belong to.
+class ColumnarScript {
+public:
+  static constexpr std::uint32_t npos = UINT32_MAX;
+
+  // Converts the elements of the script (title entries aren't included).
+  explicit ColumnarScript(const Script &script);
+
+  size_t size() const { return _types.size(); }
+
+  ElementType getType(size_t index) const { return _types[index]; }
+  const std::vector<ElementType> &getTypes() const { return _types; }
+
+  std::string_view getText(size_t index) const {
+    return _textOf(_texts[index]);
+  }
+
+  bool isForced(size_t index) const { return _flags[index] & FORCED; }
+  bool isCentered(size_t index) const { return _flags[index] & CENTERED; }
+  // Set on a dual dialogue cue and on its dialogue and parentheticals.
+  bool isDualDialogue(size_t index) const { return _flags[index] & DUAL; }
+
+  // CHARACTER, DIALOGUE, PARENTHETICAL: the cue's name and extension. Empty
+  // for dialogue that doesn't follow a character cue.
+  std::string_view getCharacterName(size_t index) const;
+  std::optional<std::string_view> getCharacterExtension(size_t index) const;
+  // Id shared by every cue with the same name, or npos.
+  CharacterId getCharacterId(size_t index) const;
+  // Id for a character name, or npos if no cue uses it.
+  CharacterId findCharacterId(std::string_view name) const;
+
+  // HEADING
+  std::optional<std::string_view> getSceneNumber(size_t index) const;
+
+  // SECTION
+  int getSectionLevel(size_t index) const;
+
+  // Calls fn(index) for each element of the given type, in order.
+  template <typename Fn> void forEachOfType(ElementType type, Fn &&fn) const {
+    const auto *types = reinterpret_cast<const unsigned char *>(_types.data());
+    const size_t count = _types.size();
+    const unsigned char tag = static_cast<unsigned char>(type);
+
+    // memchr skips over non-matching tags a vector register at a time.
+    for (size_t i = 0; i < count; i++) {
+      const void *found = std::memchr(types + i, tag, count - i);
+      if (!found)
+        break;
+      i = static_cast<const unsigned char *>(found) - types;
+      fn(i);
+    }
+  }
+
+  // Indices of all DIALOGUE elements spoken by the named character.
+  std::vector<size_t> getDialogueFor(std::string_view name) const;
+
+private:
+  enum Flags : std::uint8_t { FORCED = 1, CENTERED = 2, DUAL = 4 };
+
+  struct TextRange {
+    std::uint32_t offset = 0;
+    std::uint32_t length = 0;
+  };
+
+  struct CharacterRow {
+    TextRange name;
+    TextRange extension;
+    bool hasExtension;
+    CharacterId characterId;
+  };
+
+  struct HeadingRow {
+    TextRange sceneNumber;
+    bool hasSceneNumber;
+  };
+
+  std::string _text;
+  std::vector<ElementType> _types;
+  std::vector<TextRange> _texts;
+  std::vector<std::uint8_t> _flags;
+  // Row in the side table for the element's type, or npos.
+  std::vector<std::uint32_t> _sideRows;
+
+  std::vector<CharacterRow> _characters;
+  std::vector<HeadingRow> _headings;
+  std::vector<int> _sectionLevels;
+  // Character ids by name, handed out in order of first cue
+  StringTable _characterIds;
+
+  TextRange _addText(std::string_view text);
+  std::string_view _textOf(TextRange range) const {
+    return std::string_view(_text).substr(range.offset, range.length);
+  }
+  const CharacterRow *_getCharacterRow(size_t index) const;
+};
+
+} // namespace ScreenplayTools
+
+#endif // COLUMNAR_SCRIPT_H
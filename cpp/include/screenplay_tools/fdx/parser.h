@@ -6,6 +6,7 @@
 #include "screenplay_tools/screenplay.h"
 #include <memory>
 #include <string>
+#include <string_view>
 
 namespace ScreenplayTools {
 namespace FDX {
@@ -13,7 +14,10 @@ namespace FDX {
 class Parser {
 public:
   Parser();
-  Script Parse(const std::string &xmlContent);
+  Script Parse(std::string_view xmlContent);
+  // Memory-maps an FDX file and parses it in place. Throws std::runtime_error
+  // if the file can't be opened.
+  Script ParseFile(const std::string &path);
 
 private:
   std::unique_ptr<Script> script;
@@ -0,0 +1,92 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#pragma once
+
+#include "screenplay_tools/screenplay.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace ScreenplayTools {
+namespace FDX {
+
+class Parser;
+struct XMLResume;
+
+// Parses FDX that arrives in chunks, such as a large export being read from
+// disk or the network, and hands each paragraph's element on as soon as the
+// paragraph closes. Only the paragraph being read and any Paragraph tag cut
+// off at the end of a chunk are held on to, so memory is bounded by the
+// largest of those rather than by the document. Everything outside the
+// script's paragraphs, such as revision history, comments and embedded data,
+// is skipped over as it goes past, however many chunks it spans.
+class StreamParser {
+public:
+  StreamParser();
+  ~StreamParser();
+
+  // Called with each element, in script order. Unless keepElements is set,
+  // the element only lasts for the call, so copy it to keep it.
+  std::function<void(const Element &element)> onElement;
+
+  // Also add the elements to GetScript(), as Parser::Parse() does. Off by
+  // default, so that memory use stays bounded.
+  bool keepElements = false;
+
+  // Parses the next part of the document. Chunks can be any size and split it
+  // anywhere, even part way through a tag or a UTF-8 character.
+  void AddChunk(std::string_view chunk);
+  // Call once the whole document has been added. A document that was cut off
+  // part way still gets the paragraph it ended in.
+  void Finish();
+
+  // The elements so far if keepElements is set. Characters' cues are only
+  // interned as elements are added, so they're only set when it is.
+  const Script &GetScript() const { return _script; }
+
+  // How much input is held back because it ends part way through a token.
+  size_t GetBufferedSize() const { return _pending.size(); }
+
+private:
+  friend class Parser;
+
+  Script _script;
+  std::string _pending;
+  // Where the reader left off in _pending, so that markup running over
+  // several chunks isn't read again from its start with each one.
+  std::unique_ptr<XMLResume> _resume;
+
+  // Where in the document the reader has got to. Only the first Content in
+  // the FinalDraft root counts, with the Paragraphs directly in it and the
+  // text directly in their Texts.
+  size_t _depth = 0;
+  bool _inRoot = false;
+  bool _done = false;
+  bool _inContent = false;
+  bool _contentDone = false;
+  bool _inParagraph = false;
+  bool _inText = false;
+
+  // The paragraph being read. Its text is usually one run of one Text, which
+  // is used where it is in the input. It's only copied when there's more
+  // than one, when it has entities to decode, or when the paragraph runs
+  // past the end of a chunk.
+  std::string _type;
+  std::string_view _text;
+  std::string _textBuffer;
+  bool _buffered = false;
+
+  // Parses as much of xml as makes whole tokens, and returns how much that
+  // was. If complete is set, it's the end of the document.
+  size_t _Feed(std::string_view xml, bool complete);
+  // Returns false once the root has closed.
+  bool _Close(size_t depth);
+  // Adds a run of text, decoding its entities unless it's CDATA.
+  void _AddText(std::string_view text, bool decode);
+  void _EndParagraph();
+};
+
+} // namespace FDX
+} // namespace ScreenplayTools
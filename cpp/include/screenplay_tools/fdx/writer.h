@@ -4,6 +4,7 @@
 #pragma once
 
 #include "screenplay_tools/screenplay.h"
+#include <span>
 #include <string>
 
 namespace ScreenplayTools {
@@ -12,7 +13,15 @@ namespace FDX {
 class Writer {
 public:
   Writer();
+  // Writes in one pass, into a string reserved from an estimate of the
+  // XML's length.
   std::string Write(const Script &script);
+  // Writes the same XML into output, which must be at least Measure(script)
+  // long, and returns its length. Throws std::length_error if it doesn't fit.
+  // Measuring first makes it two passes, for callers that need the size.
+  size_t Write(const Script &script, std::span<char> output);
+  // The exact length of what Write() gives for script.
+  size_t Measure(const Script &script);
 };
 
 } // namespace FDX
@@ -0,0 +1,193 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#ifndef FOUNTAINBASICCALLBACKPARSER_H
+#define FOUNTAINBASICCALLBACKPARSER_H
+
+#include "parser.h"
+#include "screenplay_tools/utils.h"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ScreenplayTools {
+namespace Fountain {
+
+// Like CallbackParser, but calls member functions of a handler that's known at
+// compile time instead of std::functions, so each event is a direct call that
+// can be inlined. Events that the handler doesn't have cost nothing. Text is
+// passed as views into the parsed elements, which are only valid for the
+// duration of the call.
+//
+// The handler can have any of:
+//   void onTitlePage(const std::vector<std::shared_ptr<TitleEntry>> &entries);
+//   void onDialogue(std::string_view character,
+//                   std::optional<std::string_view> extension,
+//                   std::optional<std::string_view> parenthetical,
+//                   std::string_view line, bool isDualDialogue);
+//   void onAction(std::string_view text);
+//   void onSceneHeading(std::string_view text,
+//                       std::optional<std::string_view> sceneNumber);
+//   void onLyrics(std::string_view text);
+//   void onTransition(std::string_view text);
+//   void onSection(std::string_view text, int level);
+//   void onSynopsis(std::string_view text);
+//   void onPageBreak();
+template <typename Handler> class BasicCallbackParser : public Parser {
+public:
+  explicit BasicCallbackParser(Handler handler = Handler())
+      : handler(std::move(handler)) {
+    mergeActions = false;  // Callbacks need actions separated.
+    mergeDialogue = false; // Callbacks need dialogue separated.
+  }
+
+  Handler handler;
+
+  // Don't get called back if there's a blank entry
+  bool ignoreBlanks = true;
+
+  // As CallbackParser::streaming.
+  bool streaming = false;
+
+  void addLine(std::string_view inputLine) override {
+    size_t elementCount = _script->getElements().size();
+    bool wasInTitlePage = _inTitlePage;
+
+    Parser::addLine(inputLine);
+
+    const auto &entries = _script->getTitleEntries();
+    if constexpr (requires { handler.onTitlePage(entries); }) {
+      if (wasInTitlePage && !_inTitlePage)
+        handler.onTitlePage(entries);
+    }
+
+    const auto &elements = _script->getElements();
+    for (; elementCount < elements.size(); elementCount++)
+      _handleNewElement(*elements[elementCount]);
+
+    if (streaming)
+      _discardParsed();
+  }
+
+protected:
+  bool _supportsParallel() const override { return false; }
+
+private:
+  using Text = std::string_view;
+  using OptionalText = std::optional<std::string_view>;
+
+  static constexpr bool _hasDialogue =
+      requires(Handler &h, Text text, OptionalText optionalText) {
+        h.onDialogue(text, optionalText, optionalText, text, true);
+      };
+
+  // Copies of the last cue and parenthetical, as when streaming the elements
+  // don't stay around. Flagged rather than cleared, to keep the buffers.
+  CharacterInfo _lastChar;
+  bool _hasLastChar = false;
+  std::string _lastParen;
+  bool _hasLastParen = false;
+
+  static OptionalText _view(const std::optional<std::string> &text) {
+    return text ? OptionalText(*text) : std::nullopt;
+  }
+
+  bool _isBlank(const Element &elem) const {
+    return ignoreBlanks && isWhitespaceOrEmpty(elem.getTextRaw());
+  }
+
+  void _handleNewElement(const Element &elem) {
+    auto handle = overloaded{
+        [this](const Character &e) {
+          if constexpr (_hasDialogue) {
+            _lastChar.name = e.getName();
+            _lastChar.extension = e.getExtension();
+            _lastChar.dual = e.isDualDialogue();
+            _hasLastChar = true;
+          }
+        },
+
+        [this](const Parenthetical &e) {
+          if constexpr (_hasDialogue) {
+            _lastParen = e.getTextRaw();
+            _hasLastParen = true;
+          }
+        },
+
+        [this](const Dialogue &e) {
+          if constexpr (_hasDialogue) {
+            if (!_hasLastChar)
+              return;
+
+            bool hasParen = std::exchange(_hasLastParen, false);
+            if (_isBlank(e))
+              return;
+
+            handler.onDialogue(_lastChar.name, _view(_lastChar.extension),
+                               hasParen ? OptionalText(_lastParen)
+                                        : std::nullopt,
+                               e.getTextRaw(), _lastChar.dual);
+          }
+        },
+
+        [this](const Action &e) {
+          if constexpr (requires(Text text) { handler.onAction(text); }) {
+            if (!_isBlank(e))
+              handler.onAction(e.getTextRaw());
+          }
+        },
+
+        [this](const SceneHeading &e) {
+          if constexpr (requires(Text text, OptionalText number) {
+                          handler.onSceneHeading(text, number);
+                        }) {
+            if (!_isBlank(e))
+              handler.onSceneHeading(e.getTextRaw(),
+                                     _view(e.getSceneNumber()));
+          }
+        },
+
+        [this](const Lyric &e) {
+          if constexpr (requires(Text text) { handler.onLyrics(text); }) {
+            if (!_isBlank(e))
+              handler.onLyrics(e.getTextRaw());
+          }
+        },
+
+        [this](const Transition &e) {
+          if constexpr (requires(Text text) { handler.onTransition(text); }) {
+            if (!_isBlank(e))
+              handler.onTransition(e.getTextRaw());
+          }
+        },
+
+        [this](const Section &e) {
+          if constexpr (requires(Text text) { handler.onSection(text, 1); })
+            handler.onSection(e.getTextRaw(), e.getLevel());
+        },
+
+        [this](const Synopsis &e) {
+          if constexpr (requires(Text text) { handler.onSynopsis(text); })
+            handler.onSynopsis(e.getTextRaw());
+        },
+
+        [this](const PageBreak &) {
+          if constexpr (requires { handler.onPageBreak(); })
+            handler.onPageBreak();
+        },
+
+        [this](const Element &) {
+          _hasLastChar = false;
+          _hasLastParen = false;
+        }};
+
+    visit(elem, handle);
+  }
+};
+
+} // namespace Fountain
+} // namespace ScreenplayTools
+
+#endif // FOUNTAINBASICCALLBACKPARSER_H
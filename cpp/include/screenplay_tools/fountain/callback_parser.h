@@ -7,6 +7,7 @@
 #include "parser.h"
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 
 namespace ScreenplayTools {
@@ -41,13 +42,24 @@ public:
   // Don't get called back if there's a blank entry
   bool ignoreBlanks = true;
 
-  void addLine(const std::string &inputLine) override;
+  // Don't keep elements once they've been passed to the callbacks, so memory
+  // use stays flat however much text goes through. The script is left with
+  // just what's needed to parse the next line, and without its indexes. Set
+  // this before adding any text.
+  bool streaming = false;
+
+  void addLine(std::string_view inputLine) override;
+
+protected:
+  bool _supportsParallel() const override { return false; }
 
 private:
-  std::shared_ptr<Character> _lastChar;
-  std::shared_ptr<Parenthetical> _lastParen;
+  // Copied rather than pointed to, as elements don't stay around when
+  // streaming.
+  std::optional<CharacterInfo> _lastChar;
+  std::optional<std::string> _lastParen;
 
-  void _handleNewElement(const std::shared_ptr<Element> &elem);
+  void _handleNewElement(const Element &elem);
 };
 
 } // namespace Fountain
@@ -0,0 +1,138 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#ifndef FOUNTAININCREMENTALPARSER_H
+#define FOUNTAININCREMENTALPARSER_H
+
+#include "parser.h"
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ScreenplayTools {
+namespace Fountain {
+
+// Keeps a script in sync with a document that's being edited, e.g. in a text
+// editor. The parser remembers its state at checkpoints through the document,
+// so after an edit it only has to re-parse from the last checkpoint before the
+// change until its state matches what it was at the same point last time. The
+// rest of the previous parse is then reused as is.
+class IncrementalParser : protected Parser {
+public:
+  IncrementalParser();
+
+  using Parser::getScript;
+  using Parser::mergeActions;
+  using Parser::mergeDialogue;
+  using Parser::useTags;
+
+  // Minimum number of lines between checkpoints. Smaller means less to re-parse
+  // after an edit but more checkpoints to keep.
+  size_t checkpointInterval = 16;
+
+  // Parses a whole document, replacing whatever was there before. Set any
+  // options before calling this.
+  void setText(std::string_view text);
+
+  // How much an edit had to redo. It depends on the edit and what's around
+  // it, not on how long the document is.
+  struct EditWork {
+    size_t lines = 0;    // Lines re-parsed
+    size_t elements = 0; // Elements replaced, added or re-indexed
+  };
+
+  // Replaces removeCount lines starting at firstLine with newLines and updates
+  // the script to match. Elements outside the re-parsed range are kept, so
+  // pointers to them stay valid. Tags, characters and cues keep their ids, and
+  // any the edit leaves unused are freed.
+  EditWork replaceLines(size_t firstLine, size_t removeCount,
+                        std::vector<std::string> newLines);
+
+  size_t getLineCount() const { return _lineCount; }
+  const std::string &getLine(size_t line) const { return _line(line).text; }
+
+private:
+  // Parser state after a line. Elements only ever grow by having text and tags
+  // appended, so the last element is recorded as the length of its text and
+  // tag list rather than as a copy. Nothing in it depends on where the line
+  // is, so edits before it leave it as it is.
+  struct Checkpoint {
+    Element *last = nullptr;
+    size_t noteCount = 0;
+    size_t boneyardCount = 0;
+    size_t lastTextLength = 0;
+    size_t lastTagCount = 0;
+    std::vector<std::string> padActions;
+    std::vector<std::vector<TagId>> padActionTags;
+    std::vector<TagId> lineTags;
+    // Tags released before the checkpoint was taken. One whose tags have been
+    // released since refers to ids that may have gone to other tags.
+    size_t releaseCount = 0;
+    std::optional<CueId> lastCue;
+    bool lastLineWhitespaceOrEmpty = true;
+    bool lastLineEmpty = true;
+    bool inDialogue = false;
+  };
+
+  struct Line {
+    std::string text;
+    std::unique_ptr<Checkpoint> checkpoint;
+  };
+
+  // Lines are kept in blocks, like a script's elements, so that an edit only
+  // moves the lines of its own block.
+  struct LineBlock {
+    std::vector<Line> lines;
+    size_t start = 0; // Number of the block's first line
+  };
+
+  static constexpr size_t _lineBlockSize = 512;
+
+  std::vector<LineBlock> _lineBlocks;
+  size_t _lineCount = 0;
+  // Tags the parser was still holding at the end of the document, waiting for
+  // an element to go on. A full parse keeps them in the table, so they count
+  // as used.
+  std::vector<TagId> _trailingTags;
+  // When each tag was last released, counting releases from 1.
+  std::vector<size_t> _tagReleases;
+  size_t _releaseCount = 0;
+
+  // Checkpoints are taken between lines, so every line is parsed here in
+  // order, never split up by addTextParallel().
+  bool _supportsParallel() const override { return false; }
+  // _releaseUnusedTags() does this once an edit is done, without renumbering.
+  void _pruneTags() override {}
+
+  // The block holding a line, or the last block for the end of the document.
+  size_t _lineBlockIndex(size_t line) const;
+  Line &_line(size_t line);
+  const Line &_line(size_t line) const;
+  // Replaces count lines from `first` on with newLines, moved in, which have
+  // no checkpoints yet.
+  void _spliceLines(size_t first, size_t count,
+                    std::vector<std::string> newLines);
+
+  void _reset();
+  // Releases those of `tags`, and of the tags new to the script, that nothing
+  // in the script or at the end of the document uses, so that the table holds
+  // what a fresh parse's would. Clears the script's new tags.
+  void _releaseUnusedTags(std::vector<TagId> &tags);
+  // Whether any of the checkpoint's tags have been released since it was
+  // taken. It can't be resumed from or matched then.
+  bool _isStale(const Checkpoint &checkpoint) const;
+  bool _isSafePoint() const;
+  Checkpoint _makeCheckpoint() const;
+  // Puts the parser back as it was at a checkpoint, or at the start of the
+  // document for nullptr. The last element is copied into the script.
+  void _restore(const Checkpoint *checkpoint);
+  bool _matches(const Checkpoint &checkpoint) const;
+};
+
+} // namespace Fountain
+} // namespace ScreenplayTools
+
+#endif // FOUNTAININCREMENTALPARSER_H
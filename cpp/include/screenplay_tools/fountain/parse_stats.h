@@ -0,0 +1,104 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#ifndef PARSE_STATS_H
+#define PARSE_STATS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace ScreenplayTools {
+namespace Fountain {
+
+// The rules Parser::addLine() tries on a line, in the order it tries them.
+// Action is what's left when none of the others match.
+enum class ParseRule {
+  Boneyard,
+  Notes,
+  TitlePage,
+  Section,
+  ForcedAction,
+  ForcedSceneHeading,
+  ForcedCharacter,
+  ForcedTransition,
+  PageBreak,
+  Lyrics,
+  Synopsis,
+  CenteredAction,
+  SceneHeading,
+  Transition,
+  Parenthetical,
+  Character,
+  Dialogue,
+  Action,
+  Count
+};
+
+constexpr const char *getParseRuleName(ParseRule rule) {
+  constexpr const char *names[] = {
+      "Boneyard",          "Notes",             "TitlePage",
+      "Section",           "ForcedAction",      "ForcedSceneHeading",
+      "ForcedCharacter",   "ForcedTransition",  "PageBreak",
+      "Lyrics",            "Synopsis",          "CenteredAction",
+      "SceneHeading",      "Transition",        "Parenthetical",
+      "Character",         "Dialogue",          "Action"};
+  return names[static_cast<size_t>(rule)];
+}
+
+// What a Fountain::Parser did with its lines. Only kept when the library's
+// built with SCREENPLAY_TOOLS_PARSE_STATS (the CMake option of that name), as
+// Parser::stats. Otherwise the counting compiles away to nothing.
+struct ParseStats {
+  struct Rule {
+    uint64_t attempts = 0;
+    uint64_t hits = 0;
+    // Time spent in the rule, hit or miss, including adding what it parsed
+    uint64_t nanoseconds = 0;
+  };
+  std::array<Rule, static_cast<size_t>(ParseRule::Count)> rules{};
+
+  uint64_t lines = 0;
+
+  // Transitions and characters wait for the next line to decide them. These
+  // count how they turned out.
+  uint64_t transitions = 0;
+  uint64_t transitionsAsAction = 0;
+  uint64_t characters = 0;
+  uint64_t charactersAsAction = 0;
+
+  // Lines appended to the element before them rather than added as their own:
+  // action lines, blank lines padding actions, and dialogue lines.
+  uint64_t actionMerges = 0;
+  uint64_t paddingMerges = 0;
+  uint64_t dialogueMerges = 0;
+
+  Rule &operator[](ParseRule rule) {
+    return rules[static_cast<size_t>(rule)];
+  }
+  const Rule &operator[](ParseRule rule) const {
+    return rules[static_cast<size_t>(rule)];
+  }
+
+  ParseStats &operator+=(const ParseStats &other) {
+    for (size_t i = 0; i < rules.size(); i++) {
+      rules[i].attempts += other.rules[i].attempts;
+      rules[i].hits += other.rules[i].hits;
+      rules[i].nanoseconds += other.rules[i].nanoseconds;
+    }
+    lines += other.lines;
+    transitions += other.transitions;
+    transitionsAsAction += other.transitionsAsAction;
+    characters += other.characters;
+    charactersAsAction += other.charactersAsAction;
+    actionMerges += other.actionMerges;
+    paddingMerges += other.paddingMerges;
+    dialogueMerges += other.dialogueMerges;
+    return *this;
+  }
+};
+
+} // namespace Fountain
+} // namespace ScreenplayTools
+
+#endif // PARSE_STATS_H
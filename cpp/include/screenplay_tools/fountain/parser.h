@@ -4,10 +4,12 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include "screenplay_tools/fountain/parse_stats.h"
 #include "screenplay_tools/screenplay.h"
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace ScreenplayTools {
@@ -19,13 +21,22 @@ public:
 
   virtual ~Parser() = default;
 
-  // Expects \n separated UTF8 text. Splits into individual lines, adds them one
-  // by one
-  virtual void addText(const std::string &inputText);
+  // Expects \n (or \r\n) separated UTF8 text. Splits into individual lines,
+  // adds them one by one. The text is only read for the duration of the call
+  // and isn't copied beyond what ends up in the script.
+  virtual void addText(std::string_view inputText);
+  // Memory-maps a UTF8 file and parses it as with addText(), without reading
+  // it into a string first. Throws std::runtime_error if it can't be opened.
+  void parseFile(const std::string &path);
+  // Parses text as addText() does, but first splits it into chunks at scene
+  // headings that follow an empty line, and parses those on up to `threads`
+  // threads (0 for one per core). The script comes out exactly as addText()
+  // would leave it. Subclasses that hook addLine() get addText() instead.
+  void addTextParallel(std::string_view inputText, unsigned threads = 0);
   // Add an array of UTF8 lines.
   virtual void addLines(const std::vector<std::string> &lines);
   // Add an individual line.
-  virtual void addLine(const std::string &inputLine);
+  virtual void addLine(std::string_view inputLine);
   // Call this when you're sure you're done calling a series of addLine()! Some
   // to-be-decided lines may get added.
   virtual void finalizeParsing();
@@ -36,6 +47,12 @@ public:
   bool mergeDialogue = true;
   bool useTags = false;
 
+#ifdef SCREENPLAY_TOOLS_PARSE_STATS
+  // Counts and times of the rules tried on each line, for tuning. Adds up over
+  // every line parsed until it's reset.
+  ParseStats stats;
+#endif
+
 protected:
   std::shared_ptr<Script> _script;
 
@@ -47,15 +64,22 @@ protected:
   };
 
   struct SceneHeadingInfo {
-    std::string text;
+    std::string_view text;
     std::optional<std::string> sceneNumber;
   };
 
-  // Some elements don't get decided until the following line.
+  // Some elements don't get decided until the following line. Until then
+  // they're held here rather than in the script, along with the action they'll
+  // be instead if they turn out not to be what they look like.
   struct PendingElement {
-    ElementType type;                 // The type of element
-    std::shared_ptr<Element> element; // Primary FountainElement
-    std::shared_ptr<Element> backup;  // Backup FountainElement
+    ElementType type; // TRANSITION or CHARACTER
+    std::optional<Transition> transition;
+    std::optional<Character> character;
+    Action backup;
+
+    Element &element() {
+      return transition ? static_cast<Element &>(*transition) : *character;
+    }
   };
 
   bool _inTitlePage = true;
@@ -67,19 +91,63 @@ protected:
   std::string _lineBeforeNote = "";
   std::shared_ptr<Note> _currentNote = nullptr;
 
-  std::vector<std::shared_ptr<Action>> _padActions;
-  std::vector<std::shared_ptr<PendingElement>> _pending;
-
-  std::string _line = "";
-  std::string _lineTrim = "";
-  bool _lastLineWhitespaceOrEmpty = false;
-  std::string _lastLine = "";
-  std::vector<std::string> _lineTags;
+  // Blank lines after an action, which only go in if another action follows
+  std::vector<Action> _padActions;
+  std::vector<PendingElement> _pending;
+
+  // Views of the line being parsed. They point into the caller's text, or into
+  // _lineBuffer once boneyards or notes have been swapped out for references.
+  std::string_view _line;
+  std::string_view _lineTrim;
+  std::string _lineBuffer;
+  std::string _lineScratch;
+  std::string _cueBuffer;
+  bool _lastLineWhitespaceOrEmpty = true;
+  bool _lastLineEmpty = true;
+  std::vector<TagId> _lineTags;
+  std::vector<TagId> _newTags;
+  std::vector<std::string_view> _tagNames;
+
+  // Where "/*", "*/", "[[" and "]]" start in _line, from a single sweep.
+  struct Delimiters {
+    std::vector<size_t> boneyardOpens;
+    std::vector<size_t> boneyardCloses;
+    std::vector<size_t> noteOpens;
+    std::vector<size_t> noteCloses;
+  };
+  Delimiters _delimiters;
 
   bool _inDialogue = false;
 
-  std::shared_ptr<Element> _getLastElement();
-  void _addElement(std::shared_ptr<Element> element);
+  // Notes and boneyards dropped by _discardParsed(), so that the ones after
+  // them still get their own ids.
+  size_t _discardedNotes = 0;
+  size_t _discardedBoneyards = 0;
+
+  // Whether addTextParallel() can split the text up. Only the first chunk
+  // goes through addLine(), so subclasses that override it return false.
+  virtual bool _supportsParallel() const { return true; }
+
+  // Tags are interned as their line is read, but a line can be merged away or
+  // dropped along with its tags. Once parsing is finished this drops tags that
+  // nothing uses any more, so the table holds what's in the script, numbered
+  // in the order it uses them.
+  virtual void _pruneTags();
+
+  // Drops whatever later lines can't affect from the script: all but the last
+  // element, the notes and boneyards, the title page once it's over, and the
+  // script's indexes, which stop being kept.
+  void _discardParsed();
+
+  void _parseLine();
+  void _scanDelimiters();
+  void _takeLineScratch();
+  bool _isChunkStart(std::string_view line);
+
+  Element *_getLastElement();
+  // Adds an element that's been built on the side, moving it into the script
+  // unless it's merged into the last element or dropped.
+  void _addElement(Element &&element);
   void _parsePending();
 
   bool _parseTitlePage();
@@ -90,7 +158,7 @@ protected:
 
   bool _parseSynopsis();
 
-  std::optional<SceneHeadingInfo> _decodeSceneHeading(const std::string &line);
+  std::optional<SceneHeadingInfo> _decodeSceneHeading(std::string_view line);
   bool _parseForcedSceneHeading();
   bool _parseSceneHeading();
 
@@ -99,7 +167,7 @@ protected:
 
   bool _parseParenthetical();
 
-  std::optional<CharacterInfo> _decodeCharacter(const std::string &line);
+  std::optional<CharacterInfo> _decodeCharacter(std::string_view line);
   bool _parseForcedCharacter();
   bool _parseCharacter();
 
@@ -108,15 +176,16 @@ protected:
   bool _parseForcedAction();
   bool _parseCenteredAction();
   void _parseAction();
-  std::shared_ptr<Action> _createAction(const std::string &text,
-                                        bool forced = false);
+  Action _createAction(std::string_view text, bool forced = false);
 
   bool _parsePageBreak();
 
+  // Scans _line for delimiters, so _parseNotes() must come after it.
   bool _parseBoneyard();
   bool _parseNotes();
-  std::pair<std::string, std::vector<std::string>>
-  _extractTags(const std::string &line);
+  // Placeholders for the boneyard or note that was added to the script last
+  std::string _lastBoneyardTag() const;
+  std::string _lastNoteTag() const;
 };
 
 } // namespace Fountain
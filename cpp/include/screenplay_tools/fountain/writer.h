@@ -4,9 +4,14 @@
 #ifndef WRITER_H
 #define WRITER_H
 
+#include "../output_sink.h"
 #include "../screenplay.h"
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace ScreenplayTools {
 namespace Fountain {
@@ -14,24 +19,66 @@ namespace Fountain {
 class Writer {
 public:
   Writer();
+  // Writes in one pass, into a string reserved from an estimate of the
+  // output's length.
   std::string write(const Script &script);
+  // Writes the same text as write() in one pass, handing it to sink in
+  // blocks, so it never holds much more than a block of it at once.
+  void write(const Script &script, OutputSink &sink);
+  // Writes the same text into output, which must be at least
+  // measure(script) long, and returns its length. Throws std::length_error
+  // if it doesn't fit. Measuring and then writing into a buffer of exactly
+  // the right size is two passes, so it's for callers that need that.
+  size_t write(const Script &script, std::span<char> output);
+  // The exact length of what write() gives for script, found by going
+  // through the script without writing anything.
+  size_t measure(const Script &script);
   bool prettyPrint = true;
 
 private:
-  std::string _lastChar;
+  std::optional<CueId> _lastCue;
+  const Script *_script = nullptr;
 
-  std::string _writeElement(const std::shared_ptr<Element> &elem);
-  std::string _writeCharacter(const std::shared_ptr<Character> &elem);
-  std::string _writeDialogue(const std::shared_ptr<Dialogue> &elem);
-  std::string _writeParenthetical(const std::shared_ptr<Parenthetical> &elem);
-  std::string _writeAction(const std::shared_ptr<Action> &elem);
-  std::string _writeHeading(const std::shared_ptr<SceneHeading> &elem);
-  std::string _writeTransition(const std::shared_ptr<Transition> &elem);
+  // Where output goes: nowhere, just counted; into _span; or into _output,
+  // and on to _sink if there is one.
+  enum class Target { Count, Span, Buffer };
+  Target _target = Target::Buffer;
+  std::span<char> _span;
+  std::string _output;
+  OutputSink *_sink = nullptr;
+  size_t _size = 0;
 
-  std::string _addTabs(const std::string &input, int count);
+  // Line ends at the very start and end of the output are trimmed off, so
+  // they're held back until something other than a line end follows them.
+  std::string _heldLineEnds;
+  bool _firstLine = true;
+  bool _started = false;
+
+  void _writeScript(const Script &script, Target target);
+  void _beginLine();
+  void _put(std::string_view text);
+  void _put(char c);
+  void _releaseLineEnds();
+  void _emit(std::string_view text);
+
+  void _writeElement(const Element &elem);
+  void _writeCharacter(const Character &elem);
+  void _writeDialogue(const Dialogue &elem);
+  void _writeParenthetical(const Parenthetical &elem);
+  void _writeAction(const Action &elem);
+  void _writeHeading(const SceneHeading &elem);
+  void _writeTransition(const Transition &elem);
+
+  // Writes text[begin, end) with its notes and boneyards written back in
+  // place of their placeholders.
+  void _writeText(std::string_view text,
+                  const std::vector<Annotation> &annotations, size_t begin,
+                  size_t end, bool notes = true);
+  void _writeText(const Element &elem);
+  void _writeText(const std::string &text);
 };
 
 } // namespace Fountain
 } // namespace ScreenplayTools
 
-#endif // WRITER_H
\ No newline at end of file
+#endif // WRITER_H
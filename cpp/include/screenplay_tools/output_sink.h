@@ -0,0 +1,56 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace ScreenplayTools {
+
+// Somewhere for a writer to send its output. Writers hand it large blocks
+// rather than single lines, so one virtual call covers many elements.
+class OutputSink {
+public:
+  virtual ~OutputSink() = default;
+  virtual void write(std::string_view text) = 0;
+};
+
+// Writes to a stream. Failures are left in the stream's state.
+class StreamSink : public OutputSink {
+public:
+  explicit StreamSink(std::ostream &stream) : _stream(stream) {}
+  void write(std::string_view text) override {
+    _stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+  }
+
+private:
+  std::ostream &_stream;
+};
+
+// Appends to a string, which grows as needed.
+class StringSink : public OutputSink {
+public:
+  explicit StringSink(std::string &buffer) : _buffer(buffer) {}
+  void write(std::string_view text) override { _buffer += text; }
+
+private:
+  std::string &_buffer;
+};
+
+// Writes to an open file descriptor, which stays open. Throws
+// std::runtime_error if a write fails.
+class FileDescriptorSink : public OutputSink {
+public:
+  explicit FileDescriptorSink(int fd) : _fd(fd) {}
+  void write(std::string_view text) override;
+
+private:
+  int _fd;
+};
+
+} // namespace ScreenplayTools
+
+#endif // OUTPUT_SINK_H
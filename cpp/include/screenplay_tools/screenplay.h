@@ -5,16 +5,33 @@
 #define SCREENPLAY_H
 
 #include <algorithm> // For std::find
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <new>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 // Namespace ScreenplayTools
 namespace ScreenplayTools {
 
+namespace Fountain {
+class Parser;
+class IncrementalParser;
+} // namespace Fountain
+
+struct ElementBlock;
+class ElementList;
+
 // Enum for element types
-enum class ElementType {
+enum class ElementType : std::uint8_t {
   TITLEENTRY,
   HEADING,
   ACTION,
@@ -33,6 +50,30 @@ enum class ElementType {
 // Utility function to convert enums to strings
 std::string elementTypeToString(ElementType type);
 
+// Tags are interned per script (see Script::internTag()), and elements refer
+// to them by id.
+using TagId = std::uint32_t;
+
+// Character names are interned per script too. A cue is a name together with
+// an extension, so "BOB" and "BOB (V.O.)" are different cues of the same
+// character.
+using CharacterId = std::uint32_t;
+using CueId = std::uint32_t;
+
+// A Note or Boneyard that the parser cut out of some text. The text keeps a
+// placeholder in its place, "[[id]]" for a note or "/*id*/" for a boneyard,
+// which is what offset and length cover. id indexes the script's notes or
+// boneyards.
+struct Annotation {
+  ElementType type; // NOTE or BONEYARD
+  size_t offset;
+  size_t length;
+  size_t id;
+};
+
+// Finds the Note/Boneyard placeholders in text, in order.
+std::vector<Annotation> findAnnotations(std::string_view text);
+
 // Base class for all elements
 class Element {
 public:
@@ -42,23 +83,36 @@ public:
 
   ElementType getType() const { return _type; }
 
-  const std::vector<std::string> &getTags() const { return _tags; }
+  // Ids of this element's tags, in the order they were added. The names are
+  // kept by the script: see Script::getTagNames(element).
+  const std::vector<TagId> &getTagIds() const { return _tags; }
+
+  bool hasTag(TagId tag) const {
+    return std::find(_tags.begin(), _tags.end(), tag) != _tags.end();
+  }
 
   // Returns text without any Boneyard or Note references.
-  const std::string &getText() const { return _textClean; }
+  const std::string &getText() const {
+    return _hasReferences ? _textClean : _textRaw;
+  }
 
   // Returns text including Boneyard or Note references.
   const std::string &getTextRaw() const { return _textRaw; }
 
-  void appendLine(const std::string &line) {
-    _textRaw += "\n" + line;
-    _updateText();
+  // Where the Boneyard and Note references are in the raw text, in order.
+  const std::vector<Annotation> &getAnnotations() const {
+    return _annotations;
+  }
+
+  void appendLine(std::string_view line) {
+    _appendText("\n");
+    _appendText(line);
   }
 
-  void appendTags(const std::vector<std::string> &tags) {
-    for (const auto &item : tags) {
-      if (std::find(_tags.begin(), _tags.end(), item) == _tags.end()) {
-        _tags.push_back(item);
+  void appendTags(const std::vector<TagId> &tags) {
+    for (TagId tag : tags) {
+      if (!hasTag(tag)) {
+        _tags.push_back(tag);
       }
     }
   }
@@ -66,27 +120,45 @@ public:
   virtual std::string dump() const;
 
 protected:
-  Element(ElementType type, const std::string &text)
-      : _type(type), _textRaw(text) {
-    _updateText();
+  Element(ElementType type, std::string_view text) : _type(type) {
+    _appendText(text);
   }
+  // Elements are built as values and moved into a script when they're added
+  Element(const Element &) = default;
+  Element(Element &&) = default;
+  Element &operator=(const Element &) = default;
+  Element &operator=(Element &&) = default;
 
   ElementType _type;
 
-  void _updateText();
+  // Appends to the raw text, recording any references in it, and to the clean
+  // text if there is one. A reference never spans a line break, so text can
+  // be handled a line at a time.
+  void _appendText(std::string_view text);
 
 private:
+  friend class Script;
+  friend class ElementList;
+
+  // Where the element is in the script's element list: see ElementList.
+  ElementBlock *_block = nullptr;
+  std::uint32_t _slot = 0;
+
+  // Set once the raw text has a Note/Boneyard reference. Until then the raw
+  // text doubles as the clean text, so there's no second copy to keep.
+  bool _hasReferences = false;
   std::string _textRaw;
   // Clean version doesn't have Note/Boneyard references
   std::string _textClean;
-  std::vector<std::string> _tags;
+  std::vector<Annotation> _annotations;
+  std::vector<TagId> _tags;
 };
 
 // Entry on the Title Page
 // key: text
 class TitleEntry : public Element {
 public:
-  TitleEntry(const std::string &key, const std::string &text)
+  TitleEntry(std::string_view key, std::string_view text)
       : Element(ElementType::TITLEENTRY, text), _key(key) {}
 
   const std::string &getKey() const { return _key; }
@@ -100,7 +172,7 @@ protected:
 // Action text element
 class Action : public Element {
 public:
-  Action(const std::string &text, bool forced = false)
+  Action(std::string_view text, bool forced = false)
       : Element(ElementType::ACTION, text), _centered(false), _forced(forced) {}
 
   void setCentered(bool value) { _centered = value; }
@@ -117,11 +189,11 @@ protected:
 // Scene Heading
 class SceneHeading : public Element {
 public:
-  SceneHeading(const std::string &text,
-               const std::optional<std::string> &sceneNumber = std::nullopt,
+  SceneHeading(std::string_view text,
+               std::optional<std::string> sceneNumber = std::nullopt,
                bool forced = false)
-      : Element(ElementType::HEADING, text), _sceneNumber(sceneNumber),
-        _forced(forced) {}
+      : Element(ElementType::HEADING, text),
+        _sceneNumber(std::move(sceneNumber)), _forced(forced) {}
 
   const std::optional<std::string> &getSceneNumber() const {
     return _sceneNumber;
@@ -138,50 +210,60 @@ protected:
 // Character heading
 class Character : public Element {
 public:
-  Character(const std::string &name,
-            const std::optional<std::string> &extension = std::nullopt,
+  Character(std::string name,
+            std::optional<std::string> extension = std::nullopt,
             bool dual = false, bool forced = false)
-      : Element(ElementType::CHARACTER, ""), _name(name), _extension(extension),
-        _isDualDialogue(dual), _forced(forced) {}
+      : Element(ElementType::CHARACTER, ""), _name(std::move(name)),
+        _extension(std::move(extension)), _isDualDialogue(dual),
+        _forced(forced) {}
 
   const std::string &getName() const { return _name; }
   const std::optional<std::string> &getExtension() const { return _extension; }
   bool isDualDialogue() const { return _isDualDialogue; }
   bool isForced() const { return _forced; }
 
+  // Ids in the character table of the script this cue was added to. Only
+  // valid once it has been added.
+  CharacterId getCharacterId() const { return _characterId; }
+  CueId getCueId() const { return _cueId; }
+
   std::string dump() const override;
 
 protected:
+  friend class Script;
+
   std::string _name; // Character's name
   std::optional<std::string>
       _extension;       // Optional extension (e.g., "V.O.", "O.S.")
   bool _isDualDialogue; // Indicates if this is dual dialogue e.g.s ^
   bool _forced;         // Indicates if the character was forced
+  CharacterId _characterId = 0;
+  CueId _cueId = 0;
 };
 
 // Dialogue line
 class Dialogue : public Element {
 public:
-  Dialogue(const std::string &text) : Element(ElementType::DIALOGUE, text) {}
+  Dialogue(std::string_view text) : Element(ElementType::DIALOGUE, text) {}
 };
 
 // Parenthetical before dialogue
 class Parenthetical : public Element {
 public:
-  Parenthetical(const std::string &text)
+  Parenthetical(std::string_view text)
       : Element(ElementType::PARENTHETICAL, text) {}
 };
 
 // Lyric line
 class Lyric : public Element {
 public:
-  Lyric(const std::string &text) : Element(ElementType::LYRIC, text) {}
+  Lyric(std::string_view text) : Element(ElementType::LYRIC, text) {}
 };
 
 // Transition e.g. CUT TO:
 class Transition : public Element {
 public:
-  Transition(const std::string &text, bool forced = false)
+  Transition(std::string_view text, bool forced = false)
       : Element(ElementType::TRANSITION, text), _forced(forced) {}
 
   bool isForced() const { return _forced; }
@@ -199,7 +281,7 @@ public:
 // Derived class for Section
 class Section : public Element {
 public:
-  Section(const std::string &text, int level)
+  Section(std::string_view text, int level)
       : Element(ElementType::SECTION, text), _level(level) {}
 
   int getLevel() const { return _level; }
@@ -213,25 +295,265 @@ protected:
 // Synopsis
 class Synopsis : public Element {
 public:
-  Synopsis(const std::string &text) : Element(ElementType::SYNOPSIS, text) {}
+  Synopsis(std::string_view text) : Element(ElementType::SYNOPSIS, text) {}
 };
 
 // Derived class for Notes
 class Note : public Element {
 public:
-  Note(const std::string &text) : Element(ElementType::NOTE, text) {}
+  Note(std::string_view text) : Element(ElementType::NOTE, text) {}
 };
 
 // Derived class for Boneyard
 class Boneyard : public Element {
 public:
-  Boneyard(const std::string &text) : Element(ElementType::BONEYARD, text) {}
+  Boneyard(std::string_view text) : Element(ElementType::BONEYARD, text) {}
+};
+
+// Builds a visitor out of lambdas, e.g.
+//   visit(element, overloaded{[](const Action &action) { ... },
+//                             [](const auto &other) { ... }});
+template <typename... Visitors> struct overloaded : Visitors... {
+  using Visitors::operator()...;
+};
+template <typename... Visitors>
+overloaded(Visitors...) -> overloaded<Visitors...>;
+
+namespace detail {
+
+template <typename T, typename E>
+using ConstLike = std::conditional_t<std::is_const_v<E>, const T, T>;
+
+template <typename E, typename Visitor>
+decltype(auto) visitElement(E &element, Visitor &&visitor) {
+  switch (element.getType()) {
+  case ElementType::TITLEENTRY:
+    return visitor(static_cast<ConstLike<TitleEntry, E> &>(element));
+  case ElementType::HEADING:
+    return visitor(static_cast<ConstLike<SceneHeading, E> &>(element));
+  case ElementType::ACTION:
+    return visitor(static_cast<ConstLike<Action, E> &>(element));
+  case ElementType::CHARACTER:
+    return visitor(static_cast<ConstLike<Character, E> &>(element));
+  case ElementType::DIALOGUE:
+    return visitor(static_cast<ConstLike<Dialogue, E> &>(element));
+  case ElementType::PARENTHETICAL:
+    return visitor(static_cast<ConstLike<Parenthetical, E> &>(element));
+  case ElementType::LYRIC:
+    return visitor(static_cast<ConstLike<Lyric, E> &>(element));
+  case ElementType::TRANSITION:
+    return visitor(static_cast<ConstLike<Transition, E> &>(element));
+  case ElementType::PAGEBREAK:
+    return visitor(static_cast<ConstLike<PageBreak, E> &>(element));
+  case ElementType::NOTE:
+    return visitor(static_cast<ConstLike<Note, E> &>(element));
+  case ElementType::BONEYARD:
+    return visitor(static_cast<ConstLike<Boneyard, E> &>(element));
+  case ElementType::SECTION:
+    return visitor(static_cast<ConstLike<Section, E> &>(element));
+  case ElementType::SYNOPSIS:
+  default: // Every element has one of the types above
+    return visitor(static_cast<ConstLike<Synopsis, E> &>(element));
+  }
+}
+
+} // namespace detail
+
+// Calls visitor with the element as its concrete class. The class is picked by
+// getType(), so there's no RTTI, and nothing is copied. Every overload has to
+// return the same type.
+template <typename Visitor>
+decltype(auto) visit(Element &element, Visitor &&visitor) {
+  return detail::visitElement(element, std::forward<Visitor>(visitor));
+}
+
+template <typename Visitor>
+decltype(auto) visit(const Element &element, Visitor &&visitor) {
+  return detail::visitElement(element, std::forward<Visitor>(visitor));
+}
+
+// Monotonic arena that Script keeps its elements in. Memory is handed out
+// contiguously from large blocks, and the elements are destroyed and their
+// memory released all at once, when the arena is destroyed.
+class ElementArena {
+public:
+  ElementArena() = default;
+  ElementArena(const ElementArena &) = delete;
+  ElementArena &operator=(const ElementArena &) = delete;
+  ~ElementArena();
+
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    static_assert(std::is_base_of_v<Element, T>);
+    T *element = new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+    _elements.push_back(element);
+    return element;
+  }
+
+  void *allocate(size_t size, size_t alignment);
+
+  // Takes over another arena's blocks and elements, leaving it empty.
+  void adopt(ElementArena &other);
+
+private:
+  std::vector<std::unique_ptr<std::byte[]>> _blocks;
+  std::byte *_next = nullptr;
+  size_t _remaining = 0;
+  size_t _blockSize = 16 * 1024;
+  // Everything created, to be destroyed along with the arena
+  std::vector<Element *> _elements;
+};
+
+// A run of consecutive elements in an ElementList.
+struct ElementBlock {
+  std::vector<Element *> elements;
+  // Empty while none of the block's elements has an owner, as when they're
+  // all in an arena. Otherwise the owner of each element in turn.
+  std::vector<std::shared_ptr<Element>> owners;
+  size_t start = 0; // Position of the first element in the list
+};
+
+// The elements of a script in order. They're kept in blocks of a few hundred,
+// so replacing a run of them only moves the rest of their block, and each
+// element knows its block and its slot in it, so its position is found without
+// a search.
+class ElementList {
+public:
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Element *;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Element *const *;
+    using reference = Element *const &;
+
+    const_iterator() = default;
+
+    reference operator*() const { return (*_block)->elements[_slot]; }
+    pointer operator->() const { return &**this; }
+
+    const_iterator &operator++() {
+      if (++_slot == (*_block)->elements.size()) {
+        ++_block;
+        _slot = 0;
+      }
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator it = *this;
+      ++*this;
+      return it;
+    }
+
+    bool operator==(const const_iterator &other) const = default;
+
+  private:
+    friend class ElementList;
+    using BlockIterator =
+        std::vector<std::unique_ptr<ElementBlock>>::const_iterator;
+
+    const_iterator(BlockIterator block, size_t slot)
+        : _block(block), _slot(slot) {}
+
+    BlockIterator _block{};
+    size_t _slot = 0;
+  };
+
+  ElementList() = default;
+  ElementList(const ElementList &) = delete;
+  ElementList &operator=(const ElementList &) = delete;
+  ElementList(ElementList &&other) noexcept;
+  ElementList &operator=(ElementList &&other) noexcept;
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+  Element *operator[](size_t position) const;
+  Element *front() const { return _blocks.front()->elements.front(); }
+  Element *back() const { return _blocks.back()->elements.back(); }
+
+  const_iterator begin() const { return {_blocks.begin(), 0}; }
+  const_iterator end() const { return {_blocks.end(), 0}; }
+
+  // Where an element is in the list, which it has to be in.
+  size_t positionOf(const Element &element) const {
+    return element._block->start + element._slot;
+  }
+
+private:
+  friend class Script;
+  friend class Fountain::Parser;
+  friend class Fountain::IncrementalParser;
+
+  // Blocks start out this long, and are split once splicing makes them twice
+  // as long.
+  static constexpr size_t _blockSize = 512;
+
+  std::vector<std::unique_ptr<ElementBlock>> _blocks;
+  size_t _size = 0;
+
+  // The block holding a position, or the last block for the end.
+  size_t _blockIndex(size_t position) const;
+  // An iterator at a position, which may be the end.
+  const_iterator _iteratorAt(size_t position) const;
+
+  void push_back(Element *element, std::shared_ptr<Element> owner = nullptr);
+  // Takes off the last element, returning its owner if it has one.
+  std::shared_ptr<Element> pop_back();
+  // Replaces count elements from position on with those of `with`, leaving it
+  // empty. The replaced elements are freed unless an arena holds them. Costs
+  // O(count + with.size()) plus a block or two, and the block starts after
+  // the change are shifted.
+  void replace(size_t position, size_t count, ElementList &with);
+};
+
+// Hash for string-keyed maps that can be looked up with a string_view.
+struct StringHash {
+  using is_transparent = void;
+  size_t operator()(std::string_view string) const {
+    return std::hash<std::string_view>{}(string);
+  }
+};
+
+// Hands out ids for strings, in order from 0, so that each distinct string is
+// only stored once. Ids that have been released are handed out again first.
+class StringTable {
+public:
+  std::uint32_t intern(std::string_view string);
+  std::optional<std::uint32_t> find(std::string_view string) const;
+  // Frees an id that nothing uses any more. Its string reads as empty, and
+  // can't be found, until the id is handed out again.
+  void release(std::uint32_t id);
+
+  const std::string &operator[](std::uint32_t id) const { return _strings[id]; }
+  const std::vector<std::string> &getStrings() const { return _strings; }
+  size_t size() const { return _strings.size(); }
+
+private:
+  std::vector<std::string> _strings;
+  std::unordered_map<std::string, std::uint32_t, StringHash, std::equal_to<>>
+      _ids;
+  std::vector<std::uint32_t> _released;
+};
+
+// A scene heading and the elements after it, up to the next heading or
+// section.
+struct Scene {
+  SceneHeading *heading;
+  Element *last; // The scene's last element, which may be the heading
+  // The sections the scene comes under, outermost first, each followed by any
+  // synopses written for it.
+  std::vector<Element *> outline;
 };
 
 // Parsed Script
 class Script {
 public:
-  Script() {}
+  // Elements live in an arena that's only freed along with the script. Scripts
+  // that are edited in place should pass false so that replaced elements are
+  // freed as they go.
+  explicit Script(bool useArena = true)
+      : _arena(useArena ? std::make_unique<ElementArena>() : nullptr) {}
 
   const std::vector<std::shared_ptr<TitleEntry>> &getTitleEntries() const {
     return _titleEntries;
@@ -241,11 +563,12 @@ public:
     _titleEntries.push_back(titleEntry);
   }
 
-  const std::vector<std::shared_ptr<Element>> &getElements() const {
-    return _elements;
-  }
+  // The elements in script order. They belong to the script, and stay valid
+  // for as long as it does. See ElementList::positionOf() for where an
+  // element is.
+  const ElementList &getElements() const { return _elements; }
 
-  std::shared_ptr<Element> getLastElement() const {
+  Element *getLastElement() const {
     if (_elements.empty())
       return nullptr;
     return _elements.back();
@@ -263,18 +586,202 @@ public:
     _boneyards.push_back(boneyard);
   }
 
+  // Returns the id for a tag name, adding it to the table if it's new. Ids
+  // are handed out in order from 0. An edit that leaves a tag unused (see
+  // Fountain::IncrementalParser) frees its id, which reads as an empty name
+  // until a new tag takes it.
+  TagId internTag(std::string_view name);
+
+  std::optional<TagId> findTag(std::string_view name) const {
+    return _tags.find(name);
+  }
+
+  const std::string &getTagName(TagId tag) const { return _tags[tag]; }
+
+  const std::vector<std::string> &getTagNames() const {
+    return _tags.getStrings();
+  }
+
+  // The names of an element's tags, in the order they were added. The element
+  // must have been tagged by this script, as any element added to it has.
+  std::vector<std::string> getTagNames(const Element &element) const;
+
+  // Tags an element by name, interning any new names. Tags it already has
+  // aren't added again.
+  void appendTags(Element &element, const std::vector<std::string> &names);
+
+  // Elements with the given tag, in script order. Looked up in an index that's
+  // kept as elements are added, so it costs O(number found).
+  std::vector<Element *> getElementsWithTag(std::string_view name) const;
+
+  // Characters are added to the table, in order from 0, as their first cue is
+  // added to the script. An edit that removes a character's last cue (see
+  // Fountain::IncrementalParser) frees its id, which reads as an empty name
+  // until a new character takes it. The ids of characters still in the script
+  // never change.
+  std::optional<CharacterId> findCharacter(std::string_view name) const {
+    return _characters.find(name);
+  }
+
+  const std::string &getCharacterName(CharacterId character) const {
+    return _characters[character];
+  }
+
+  const std::vector<std::string> &getCharacterNames() const {
+    return _characters.getStrings();
+  }
+
+  // The dialogue and parentheticals under a character's cues, in script
+  // order. Like tags, these are indexed as elements are added.
+  std::vector<Element *> getDialogueFor(CharacterId character) const;
+
+  // Scenes in script order, so the nth scene is getScenes()[n]. They refer to
+  // their elements rather than to positions, so that an edit only has to
+  // update the scenes around it.
+  const std::vector<Scene> &getScenes() const { return _scenes; }
+
+  // The first scene with the given scene number, or nullptr.
+  const Scene *findScene(std::string_view sceneNumber) const;
+
+  // The scene that the element at `position` is in, or nullptr if it isn't in
+  // one.
+  const Scene *getSceneAt(size_t position) const;
+
   std::string dump() const;
 
+  // Adds an element by moving it into the script's arena, or onto the heap for
+  // a script without one. Returns the element as added, or nullptr if it was
+  // merged into the last one.
+  Element *addElement(Element &&element, bool allowMerge = false);
+  // Adds an element that's shared with the caller, who can keep hold of it.
   void addElement(const std::shared_ptr<Element> &element,
                   bool allowMerge = false);
 
 protected:
+  friend class Fountain::Parser;
+  friend class Fountain::IncrementalParser;
+
+  std::unique_ptr<ElementArena> _arena;
   std::vector<std::shared_ptr<TitleEntry>> _titleEntries;
-  std::vector<std::shared_ptr<Element>> _elements;
+  // Elements in script order. Those made without an arena, or added as a
+  // shared_ptr, are owned by the list.
+  ElementList _elements;
   std::vector<std::shared_ptr<Note>> _notes;
   std::vector<std::shared_ptr<Boneyard>> _boneyards;
-  std::string _lastChar; // Last character name with extension, used for CONT'D
-                         // detection
+  // Last cue, used for CONT'D detection. Reset by anything other than
+  // dialogue or a parenthetical.
+  std::optional<CueId> _lastCue;
+
+  StringTable _tags;
+
+  // The elements with each tag, by tag id, in script order. The last element
+  // can still have tags merged into it, so it's only indexed once another
+  // element follows it.
+  std::vector<std::vector<Element *>> _tagIndex;
+
+  // Whether to note the ids that internTag() hands out, for a parser that
+  // frees the tags that end up unused. A line's tags are interned as it's read
+  // but can be dropped along with it, so they're checked once it's done.
+  bool _noteNewTags = false;
+  std::vector<TagId> _newTags;
+
+  // Cues are looked up by character and extension id, with an empty extension
+  // standing in for none. Each counts the cue elements in the script that use
+  // it, and each character and extension counts the cues that use it, so that
+  // edits can free whatever they leave unused. Elements that a streaming
+  // parser drops aren't counted off, so it never frees any.
+  struct Cue {
+    CharacterId character;
+    std::uint32_t extension;
+    std::uint32_t uses = 0;
+  };
+
+  StringTable _characters;
+  StringTable _extensions;
+  std::vector<Cue> _cues;
+  std::unordered_map<std::uint64_t, CueId> _cueIds;
+  std::vector<std::uint32_t> _characterCues;
+  std::vector<std::uint32_t> _extensionCues;
+  std::vector<CueId> _releasedCues;
+
+  // The dialogue and parentheticals for each character, by id, in script
+  // order.
+  std::vector<std::vector<Element *>> _dialogueIndex;
+
+  // Whether to keep the tag, dialogue and scene indexes. Streaming parsers
+  // turn this off, as they drop elements once they've been handed on.
+  bool _keepIndexes = true;
+
+  std::vector<Scene> _scenes;
+  // Headings by scene number. Numbers needn't be unique, so findScene() picks
+  // the first of them.
+  std::unordered_multimap<std::string, SceneHeading *, StringHash,
+                          std::equal_to<>>
+      _sceneNumbers;
+  // Outline that the next scene comes under, and whether the last scene is
+  // still taking elements.
+  std::vector<Element *> _outline;
+  bool _inScene = false;
+
+  // Checks whether an element merges into the last one, taking it if so, and
+  // otherwise indexes the last one ready for the element to follow it.
+  bool _prepareToAdd(Element &element, bool allowMerge);
+  // Adds an element that has just been appended to the dialogue and scene
+  // indexes.
+  void _indexAdded(Element *element);
+  // Moves an element into the arena or onto the heap and appends it to
+  // _elements, without merging or indexing it.
+  Element *_pushElement(Element &&element);
+  // Appends another script's elements, taking over its arena, and moves their
+  // cues over to this script's table. They aren't indexed, and their tags
+  // keep `from`'s ids.
+  void _appendElements(Script &from);
+  // Moves the elements out of the arena onto the heap and frees the arena,
+  // so that from now on elements are freed as they're dropped.
+  void _dropArena();
+
+  CueId _internCue(std::string_view name, std::string_view extension);
+  // Sets a character element's ids from this script's table.
+  void _internCue(Character &character);
+  // Counts a cue element in or out of the script. The cue is freed once none
+  // are left, along with its character and extension if no other cue has
+  // them.
+  void _useCue(CueId cue) { _cues[cue].uses++; }
+  void _releaseCue(CueId cue);
+
+  // Adds an element to the end of the scene index.
+  void _indexScene(Element *element);
+  // The first scene whose heading is at `position` or after it.
+  size_t _firstSceneFrom(size_t position) const;
+  void _eraseSceneNumber(const SceneHeading &heading);
+  // The character whose dialogue an element at `position` would be, found by
+  // looking back to the last cue.
+  std::optional<CharacterId> _speakerAt(size_t position) const;
+
+  // Drops index entries from `position` on and indexes the elements from there
+  // to the end. For code that appends to _elements directly.
+  void _reindexFrom(size_t position);
+  // Replaces count elements from `position` on with `elements`, leaving it
+  // empty, and updates the indexes to match. Dropped elements are freed
+  // unless they're in the arena; their cues are the caller's to count off.
+  // The indexes are only touched around the change: the scenes are replayed
+  // from the one before it up to the first later heading whose outline comes
+  // out the same, so only a script without later headings replays to the end.
+  // Returns how many elements were looked at.
+  size_t _replaceElements(size_t position, size_t count,
+                          ElementList &elements);
+  // Renumbers the tag table in the order the title entries and elements first
+  // use each tag, followed by `waiting`, the parser's elements that aren't in
+  // the script yet. Names none of them use are dropped. Returns the new id for
+  // each old one, or nullopt for one that's gone.
+  std::vector<std::optional<TagId>>
+  _renumberTags(const std::vector<Element *> &waiting = {});
+
+  // Whether anything in the script has the tag: a title entry, or an element
+  // as found in the index or last.
+  bool _isTagUsed(TagId tag) const;
+  // Swaps an element's tag ids from `from`'s table over to this one.
+  void _importTags(Element &element, const Script &from);
 };
 
 } // namespace ScreenplayTools
@@ -2,15 +2,17 @@
 #define SCREENPLAY_UTILS_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace ScreenplayTools {
 
 std::string trim(const std::string &str);
+std::string_view trimView(std::string_view str);
 std::string trimOuterNewlines(const std::string &str);
 std::string replaceAll(std::string str, const std::string &from,
                        const std::string &to);
-bool isWhitespaceOrEmpty(const std::string &str);
+bool isWhitespaceOrEmpty(std::string_view str);
 std::string join(const std::vector<std::string> &strings,
                  const std::string &delimiter);
 
@@ -0,0 +1,181 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "screenplay_tools/columnar_script.h"
+#include <stdexcept>
+
+namespace ScreenplayTools {
+
+ColumnarScript::ColumnarScript(const Script &script) {
+  const auto &elements = script.getElements();
+  if (elements.size() >= npos)
+    throw std::length_error("Script has too many elements");
+
+  _types.reserve(elements.size());
+  _texts.reserve(elements.size());
+  _flags.reserve(elements.size());
+  _sideRows.reserve(elements.size());
+
+  std::uint32_t currentCue = npos;
+
+  for (const auto &element : elements) {
+    std::uint8_t flags = 0;
+    std::uint32_t sideRow = npos;
+
+    switch (element->getType()) {
+    case ElementType::CHARACTER: {
+      const auto &character = static_cast<const Character &>(*element);
+      CharacterRow row{_addText(character.getName()), {}, false, npos};
+      if (character.getExtension()) {
+        row.extension = _addText(*character.getExtension());
+        row.hasExtension = true;
+      }
+
+      row.characterId = _characterIds.intern(character.getName());
+
+      if (character.isForced())
+        flags |= FORCED;
+      if (character.isDualDialogue())
+        flags |= DUAL;
+
+      currentCue = static_cast<std::uint32_t>(_characters.size());
+      _characters.push_back(row);
+      sideRow = currentCue;
+      break;
+    }
+
+    case ElementType::DIALOGUE:
+    case ElementType::PARENTHETICAL:
+      sideRow = currentCue;
+      // The previous element belongs to the same cue
+      if (currentCue != npos && (_flags.back() & DUAL))
+        flags |= DUAL;
+      break;
+
+    case ElementType::HEADING: {
+      const auto &heading = static_cast<const SceneHeading &>(*element);
+      HeadingRow row{{}, false};
+      if (heading.getSceneNumber()) {
+        row.sceneNumber = _addText(*heading.getSceneNumber());
+        row.hasSceneNumber = true;
+      }
+      if (heading.isForced())
+        flags |= FORCED;
+      sideRow = static_cast<std::uint32_t>(_headings.size());
+      _headings.push_back(row);
+      break;
+    }
+
+    case ElementType::SECTION:
+      sideRow = static_cast<std::uint32_t>(_sectionLevels.size());
+      _sectionLevels.push_back(
+          static_cast<const Section &>(*element).getLevel());
+      break;
+
+    case ElementType::ACTION: {
+      const auto &action = static_cast<const Action &>(*element);
+      if (action.isForced())
+        flags |= FORCED;
+      if (action.isCentered())
+        flags |= CENTERED;
+      break;
+    }
+
+    case ElementType::TRANSITION:
+      if (static_cast<const Transition &>(*element).isForced())
+        flags |= FORCED;
+      break;
+
+    default:
+      break;
+    }
+
+    if (element->getType() != ElementType::CHARACTER &&
+        element->getType() != ElementType::DIALOGUE &&
+        element->getType() != ElementType::PARENTHETICAL)
+      currentCue = npos;
+
+    _types.push_back(element->getType());
+    _texts.push_back(_addText(element->getText()));
+    _flags.push_back(flags);
+    _sideRows.push_back(sideRow);
+  }
+}
+
+ColumnarScript::TextRange ColumnarScript::_addText(std::string_view text) {
+  if (_text.size() + text.size() >= npos)
+    throw std::length_error("Script text is too large");
+
+  TextRange range{static_cast<std::uint32_t>(_text.size()),
+                  static_cast<std::uint32_t>(text.size())};
+  _text += text;
+  return range;
+}
+
+const ColumnarScript::CharacterRow *
+ColumnarScript::_getCharacterRow(size_t index) const {
+  switch (_types[index]) {
+  case ElementType::CHARACTER:
+  case ElementType::DIALOGUE:
+  case ElementType::PARENTHETICAL:
+    return _sideRows[index] != npos ? &_characters[_sideRows[index]] : nullptr;
+  default:
+    return nullptr;
+  }
+}
+
+std::string_view ColumnarScript::getCharacterName(size_t index) const {
+  const CharacterRow *row = _getCharacterRow(index);
+  return row ? _textOf(row->name) : std::string_view();
+}
+
+std::optional<std::string_view>
+ColumnarScript::getCharacterExtension(size_t index) const {
+  const CharacterRow *row = _getCharacterRow(index);
+  if (!row || !row->hasExtension)
+    return std::nullopt;
+  return _textOf(row->extension);
+}
+
+CharacterId ColumnarScript::getCharacterId(size_t index) const {
+  const CharacterRow *row = _getCharacterRow(index);
+  return row ? row->characterId : npos;
+}
+
+CharacterId ColumnarScript::findCharacterId(std::string_view name) const {
+  return _characterIds.find(name).value_or(npos);
+}
+
+std::optional<std::string_view>
+ColumnarScript::getSceneNumber(size_t index) const {
+  if (_types[index] != ElementType::HEADING)
+    return std::nullopt;
+  const HeadingRow &row = _headings[_sideRows[index]];
+  if (!row.hasSceneNumber)
+    return std::nullopt;
+  return _textOf(row.sceneNumber);
+}
+
+int ColumnarScript::getSectionLevel(size_t index) const {
+  if (_types[index] != ElementType::SECTION)
+    return 0;
+  return _sectionLevels[_sideRows[index]];
+}
+
+std::vector<size_t>
+ColumnarScript::getDialogueFor(std::string_view name) const {
+  std::vector<size_t> result;
+
+  CharacterId characterId = findCharacterId(name);
+  if (characterId == npos)
+    return result;
+
+  forEachOfType(ElementType::DIALOGUE, [&](size_t index) {
+    std::uint32_t row = _sideRows[index];
+    if (row != npos && _characters[row].characterId == characterId)
+      result.push_back(index);
+  });
+  return result;
+}
+
+} // namespace ScreenplayTools
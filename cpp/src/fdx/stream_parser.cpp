@@ -0,0 +1,202 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "screenplay_tools/fdx/stream_parser.h"
+#include "xml_entities.h"
+#include "xml_reader.h"
+#include <cctype>
+
+namespace ScreenplayTools {
+namespace FDX {
+
+namespace {
+
+// The depths of the elements that matter
+enum Depth { Root = 1, Content, Paragraph, Text };
+
+std::string_view trimSpace(std::string_view text) {
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back())))
+    text.remove_suffix(1);
+  while (!text.empty() &&
+         std::isspace(static_cast<unsigned char>(text.front())))
+    text.remove_prefix(1);
+  return text;
+}
+
+// Builds the element for a paragraph of this type and text, and passes it to
+// add.
+template <typename Add>
+void createParagraph(std::string_view type, std::string_view text, Add &&add) {
+  if (type == "Scene Heading" || type == "Scene Heading (Top of Page)" ||
+      type == "Shot") {
+    add(SceneHeading(text));
+  } else if (type == "Action" || type == "General") {
+    add(Action(text));
+  } else if (type == "Character") {
+    // Parse NAME (EXT)
+    std::string_view name = trimSpace(text);
+    std::optional<std::string> extension;
+
+    if (!name.empty() && name.back() == ')') {
+      size_t openParen = name.rfind('(');
+      if (openParen != std::string_view::npos && openParen > 0) {
+        std::string_view ext =
+            name.substr(openParen + 1, name.length() - openParen - 2);
+        if (!ext.empty())
+          extension = std::string(ext);
+        name = name.substr(0, openParen);
+        while (!name.empty() &&
+               std::isspace(static_cast<unsigned char>(name.back())))
+          name.remove_suffix(1);
+      }
+    }
+
+    add(Character(std::string(name), extension));
+  } else if (type == "Dialogue") {
+    add(Dialogue(text));
+  } else if (type == "Parenthetical") {
+    std::string_view pText = trimSpace(text);
+    if (pText.size() >= 2 && pText.front() == '(' && pText.back() == ')')
+      pText = trimSpace(pText.substr(1, pText.length() - 2));
+    add(Parenthetical(pText));
+  } else if (type == "Transition") {
+    add(Transition(text));
+  } else {
+    add(Action(text));
+  }
+}
+
+} // namespace
+
+StreamParser::StreamParser() : _resume(std::make_unique<XMLResume>()) {}
+
+StreamParser::~StreamParser() = default;
+
+void StreamParser::AddChunk(std::string_view chunk) {
+  if (_done)
+    return;
+
+  // Parse straight from the chunk unless there's the start of a token left
+  // over from the last one
+  if (_pending.empty()) {
+    const size_t used = _Feed(chunk, false);
+    _pending.assign(chunk.substr(used));
+  } else {
+    _pending += chunk;
+    const size_t used = _Feed(_pending, false);
+    _pending.erase(0, used);
+  }
+}
+
+void StreamParser::Finish() {
+  if (!_done)
+    _Feed(_pending, true);
+  _pending.clear();
+  _done = true;
+}
+
+size_t StreamParser::_Feed(std::string_view xml, bool complete) {
+  XMLReader reader(xml, complete, *_resume);
+
+  while (!_done) {
+    const XMLReader::Token token = reader.Next();
+
+    if (token.type == XMLReader::TokenType::StartTag) {
+      // Anything before the root is skipped
+      if (!_inRoot) {
+        if (token.name != "FinalDraft")
+          continue;
+        _inRoot = true;
+      }
+
+      const size_t opening = _depth + 1;
+      if (opening == Content && !_contentDone && token.name == "Content") {
+        _inContent = true;
+      } else if (opening == Paragraph && _inContent &&
+                 token.name == "Paragraph") {
+        _inParagraph = true;
+        _type.clear();
+        appendDecoded(_type, XMLReader::GetAttribute(token.attributes, "Type")
+                                 .value_or("Action"));
+        _text = {};
+        _textBuffer.clear();
+        _buffered = false;
+      } else if (opening == Text && _inParagraph && token.name == "Text") {
+        _inText = true;
+      }
+
+      if (!token.selfClosing)
+        _depth = opening;
+      else if (!_Close(opening))
+        _done = true;
+    } else if (token.type == XMLReader::TokenType::EndTag) {
+      // End tags aren't matched by name: each closes whatever's innermost
+      if (_inRoot && !_Close(_depth--))
+        _done = true;
+    } else if (token.type == XMLReader::TokenType::Text) {
+      if (_inText && _depth == Text)
+        _AddText(token.text, !token.cdata);
+    } else if (token.type == XMLReader::TokenType::Incomplete) {
+      // Only a paragraph's attributes are wanted, so any other tag that runs
+      // past the end of xml is skipped rather than held on to
+      const bool wanted = _inContent && _depth + 1 == Paragraph &&
+                          token.name == "Paragraph";
+      if (!token.name.empty() && !wanted)
+        reader.SkipTag(token.name);
+      // The rest of xml is about to go, so the paragraph's text can't point
+      // into it any more
+      if (_inParagraph && !_buffered) {
+        _textBuffer.assign(_text);
+        _buffered = true;
+      }
+      *_resume = reader.GetResume();
+      return reader.GetPosition();
+    } else {
+      if (_inParagraph)
+        _EndParagraph();
+      _done = true;
+    }
+  }
+  return xml.size();
+}
+
+bool StreamParser::_Close(size_t depth) {
+  if (depth == Text)
+    _inText = false;
+  else if (depth == Paragraph && _inParagraph)
+    _EndParagraph();
+  else if (depth == Content && _inContent)
+    _inContent = false, _contentDone = true;
+  return depth > Root;
+}
+
+void StreamParser::_AddText(std::string_view text, bool decode) {
+  decode = decode && text.find('&') != std::string_view::npos;
+  if (!decode && _text.empty() && !_buffered) {
+    _text = text;
+    return;
+  }
+  if (!_buffered)
+    _textBuffer.assign(_text);
+  if (decode)
+    appendDecoded(_textBuffer, text);
+  else
+    _textBuffer += text;
+  _buffered = true;
+}
+
+void StreamParser::_EndParagraph() {
+  _inParagraph = false;
+  createParagraph(_type, _buffered ? std::string_view(_textBuffer) : _text,
+                  [this](Element &&element) {
+                    const Element *added = &element;
+                    if (keepElements)
+                      added = _script.addElement(std::move(element));
+                    if (onElement)
+                      onElement(*added);
+                  });
+  _text = {};
+}
+
+} // namespace FDX
+} // namespace ScreenplayTools
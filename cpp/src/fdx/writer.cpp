@@ -2,83 +2,133 @@
 // for details. Copyright (c) 2024 Ian Thomas
 
 #include "screenplay_tools/fdx/writer.h"
-#include <sstream>
+#include "xml_entities.h"
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
 
 namespace ScreenplayTools {
 namespace FDX {
 
-Writer::Writer() {}
+namespace {
 
-std::string Writer::Write(const Script &script) {
-  std::stringstream xml;
-  xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
-  xml << "<FinalDraft DocumentType=\"Script\" Template=\"No\" Version=\"1\">\n";
-  xml << "  <Content>\n";
+// The places writeScript() can write to. Each takes the output a piece at a
+// time: one counts it, one appends it to a string and one copies it into a
+// fixed buffer.
+struct Counter {
+  size_t size = 0;
+  void append(std::string_view text) { size += text.size(); }
+};
+
+struct StringOutput {
+  std::string &output;
+  void append(std::string_view text) { output += text; }
+};
+
+struct SpanOutput {
+  std::span<char> output;
+  size_t size = 0;
+  void append(std::string_view text) {
+    if (text.size() > output.size() - size)
+      throw std::length_error("FDX output is longer than its buffer");
+    std::memcpy(output.data() + size, text.data(), text.size());
+    size += text.size();
+  }
+};
+
+// Roughly how long the XML for script will be: its text, and the markup
+// around each paragraph
+size_t estimateSize(const Script &script) {
+  size_t size = 160;
+  for (const auto &element : script.getElements())
+    size += element->getText().size() + 72;
+  return size + size / 16;
+}
+
+template <typename Output>
+void writeScript(const Script &script, Output &output) {
+  output.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  output.append(
+      "<FinalDraft DocumentType=\"Script\" Template=\"No\" Version=\"1\">\n");
+  output.append("  <Content>\n");
 
   for (const auto &element : script.getElements()) {
-    std::string pType = "Action";
-    std::string text =
-        element->getText(); // Assuming GetText exists and returns plain text
-
-    switch (element->getType()) {
-    case ElementType::HEADING:
-      pType = "Scene Heading";
-      // Scene headings don't have scene numbers in stored text, they are
-      // separate property usually
-      break;
-    case ElementType::ACTION:
-      pType = "Action";
-      break;
-    case ElementType::CHARACTER:
-      pType = "Character";
-      {
-        auto charElem = std::dynamic_pointer_cast<Character>(element);
-        if (charElem) {
-          text = charElem->getName();
-          if (charElem->getExtension().has_value()) {
-            text += " (" + charElem->getExtension().value() + ")";
-          }
-        }
-      }
-      break;
-    case ElementType::DIALOGUE:
-      pType = "Dialogue";
-      break;
-    case ElementType::PARENTHETICAL:
-      pType = "Parenthetical";
-      if (text.size() > 0 && text[0] != '(') {
-        text = "(" + text + ")";
-      }
-      break;
-    case ElementType::TRANSITION:
-      pType = "Transition";
-      break;
-    default:
+    const std::string &text = element->getText();
+    const char *pType = nullptr;
+
+    // The paragraph's text, written straight into the output
+    auto writeText = [&] {
+      visit(*element,
+            overloaded{
+                [&](const Character &charElem) {
+                  appendEscaped(output, charElem.getName());
+                  if (charElem.getExtension().has_value()) {
+                    output.append(" (");
+                    appendEscaped(output, charElem.getExtension().value());
+                    output.append(")");
+                  }
+                },
+                [&](const Parenthetical &) {
+                  const bool bracket = text.size() > 0 && text[0] != '(';
+                  if (bracket)
+                    output.append("(");
+                  appendEscaped(output, text);
+                  if (bracket)
+                    output.append(")");
+                },
+                [&](const Element &) { appendEscaped(output, text); }});
+    };
+
+    visit(*element,
+          overloaded{
+              [&](const SceneHeading &) {
+                pType = "Scene Heading";
+                // Scene headings don't have scene numbers in stored text, they
+                // are separate property usually
+              },
+              [&](const Action &) { pType = "Action"; },
+              [&](const Character &) { pType = "Character"; },
+              [&](const Dialogue &) { pType = "Dialogue"; },
+              [&](const Parenthetical &) { pType = "Parenthetical"; },
+              [&](const Transition &) { pType = "Transition"; },
+              [](const Element &) {}});
+
+    if (!pType)
       continue; // Skip unknown?
-    }
-
-    // Escape text
-    std::string escapedText;
-    for (char c : text) {
-      if (c == '<')
-        escapedText += "&lt;";
-      else if (c == '>')
-        escapedText += "&gt;";
-      else if (c == '&')
-        escapedText += "&amp;";
-      else
-        escapedText += c;
-    }
-
-    xml << "    <Paragraph Type=\"" << pType << "\">\n";
-    xml << "      <Text>" << escapedText << "</Text>\n";
-    xml << "    </Paragraph>\n";
+
+    output.append("    <Paragraph Type=\"");
+    appendEscaped(output, pType, true);
+    output.append("\">\n      <Text>");
+    writeText();
+    output.append("</Text>\n    </Paragraph>\n");
   }
 
-  xml << "  </Content>\n";
-  xml << "</FinalDraft>\n";
+  output.append("  </Content>\n");
+  output.append("</FinalDraft>\n");
+}
+
+} // namespace
+
+Writer::Writer() {}
+
+std::string Writer::Write(const Script &script) {
+  std::string xml;
+  xml.reserve(estimateSize(script));
+  StringOutput output{xml};
+  writeScript(script, output);
+  return xml;
+}
+
+size_t Writer::Write(const Script &script, std::span<char> output) {
+  SpanOutput span{output};
+  writeScript(script, span);
+  return span.size;
+}
 
-  return xml.str();
+size_t Writer::Measure(const Script &script) {
+  Counter counter;
+  writeScript(script, counter);
+  return counter.size;
 }
 
 } // namespace FDX
@@ -0,0 +1,199 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ScreenplayTools {
+namespace FDX {
+
+// The longest reference decoded, from the '&' to the ';'. Anything longer is
+// left as it is, so an '&' further back than this from the end of a chunk
+// can't be the start of one.
+constexpr size_t maxEntityLength = 32;
+
+namespace detail {
+
+inline bool isEscapable(char c, bool attribute) {
+  return c == '<' || c == '>' || c == '&' ||
+         (attribute && (c == '"' || c == '\''));
+}
+
+// The character a reference between its '&' and ';' stands for, as UTF-8
+// in buffer, or nothing if it isn't one of the five predefined entities or a
+// valid decimal or hex character reference.
+inline std::optional<std::string_view> resolveEntity(std::string_view name,
+                                                     char (&buffer)[4]) {
+  if (name == "lt")
+    return "<";
+  if (name == "gt")
+    return ">";
+  if (name == "amp")
+    return "&";
+  if (name == "quot")
+    return "\"";
+  if (name == "apos")
+    return "'";
+  if (name.size() < 2 || name[0] != '#')
+    return std::nullopt;
+
+  const bool hex = name[1] == 'x';
+  const std::string_view digits = name.substr(hex ? 2 : 1);
+  if (digits.empty())
+    return std::nullopt;
+  char32_t code = 0;
+  for (char c : digits) {
+    unsigned digit;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (hex && c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else if (hex && c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+    else
+      return std::nullopt;
+    code = code * (hex ? 16 : 10) + digit;
+    if (code > 0x10FFFF)
+      return std::nullopt;
+  }
+  if (code == 0 || (code >= 0xD800 && code <= 0xDFFF))
+    return std::nullopt;
+
+  if (code < 0x80) {
+    buffer[0] = static_cast<char>(code);
+    return std::string_view(buffer, 1);
+  }
+  if (code < 0x800) {
+    buffer[0] = static_cast<char>(0xC0 | (code >> 6));
+    buffer[1] = static_cast<char>(0x80 | (code & 0x3F));
+    return std::string_view(buffer, 2);
+  }
+  if (code < 0x10000) {
+    buffer[0] = static_cast<char>(0xE0 | (code >> 12));
+    buffer[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    buffer[2] = static_cast<char>(0x80 | (code & 0x3F));
+    return std::string_view(buffer, 3);
+  }
+  buffer[0] = static_cast<char>(0xF0 | (code >> 18));
+  buffer[1] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+  buffer[2] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+  buffer[3] = static_cast<char>(0x80 | (code & 0x3F));
+  return std::string_view(buffer, 4);
+}
+
+} // namespace detail
+
+// The position of the first character from pos that has to be escaped: '<',
+// '>' and '&', and in an attribute value both quotes as well. With SSE2
+// that's sixteen characters per step, so text with none in it is a single
+// sweep.
+inline size_t findEscapable(std::string_view text, size_t pos,
+                            bool attribute) {
+  const char *data = text.data();
+#if defined(__SSE2__)
+  const __m128i lt = _mm_set1_epi8('<');
+  const __m128i gt = _mm_set1_epi8('>');
+  const __m128i amp = _mm_set1_epi8('&');
+  const __m128i quot = _mm_set1_epi8(attribute ? '"' : '<');
+  const __m128i apos = _mm_set1_epi8(attribute ? '\'' : '<');
+  for (; pos + 16 <= text.size(); pos += 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+    const __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, lt), _mm_cmpeq_epi8(chunk, gt)),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, amp),
+                     _mm_or_si128(_mm_cmpeq_epi8(chunk, quot),
+                                  _mm_cmpeq_epi8(chunk, apos))));
+    if (const unsigned mask = _mm_movemask_epi8(hits))
+      return pos + std::countr_zero(mask);
+  }
+#endif
+  for (; pos < text.size(); pos++) {
+    if (detail::isEscapable(data[pos], attribute))
+      return pos;
+  }
+  return std::string_view::npos;
+}
+
+// Appends text to output with the characters findEscapable() finds replaced
+// by entities. The runs between them are appended whole.
+template <typename Output>
+void appendEscaped(Output &output, std::string_view text,
+                   bool attribute = false) {
+  size_t start = 0;
+  size_t pos;
+  while ((pos = findEscapable(text, start, attribute)) !=
+         std::string_view::npos) {
+    output.append(text.substr(start, pos - start));
+    switch (text[pos]) {
+    case '<':
+      output.append("&lt;");
+      break;
+    case '>':
+      output.append("&gt;");
+      break;
+    case '&':
+      output.append("&amp;");
+      break;
+    case '"':
+      output.append("&quot;");
+      break;
+    default:
+      output.append("&apos;");
+      break;
+    }
+    start = pos + 1;
+  }
+  output.append(text.substr(start));
+}
+
+// Appends text to output with its references to the predefined entities and
+// its character references replaced by the characters they stand for. Any
+// '&' that doesn't start one is kept as it is. The runs between them are
+// appended whole; finding the next '&' goes through memchr, which the C
+// library vectorizes.
+inline void appendDecoded(std::string &output, std::string_view text) {
+  size_t start = 0;
+  size_t amp = 0;
+  while ((amp = text.find('&', amp)) != std::string_view::npos) {
+    const size_t end =
+        text.substr(amp + 1, maxEntityLength - 1).find_first_of(";&");
+    char buffer[4];
+    std::optional<std::string_view> decoded;
+    if (end != std::string_view::npos && text[amp + 1 + end] == ';')
+      decoded = detail::resolveEntity(text.substr(amp + 1, end), buffer);
+    if (!decoded) {
+      amp++;
+      continue;
+    }
+    output.append(text.substr(start, amp - start));
+    output.append(*decoded);
+    amp += end + 2;
+    start = amp;
+  }
+  output.append(text.substr(start));
+}
+
+// How much of text, which runs to the end of a chunk, can be decoded before
+// the next chunk arrives. A reference cut off at the end of it is left for
+// when the rest of it has arrived.
+inline size_t decodableLength(std::string_view text) {
+  const size_t tail = std::min(text.size(), maxEntityLength - 1);
+  const size_t amp = text.substr(text.size() - tail).rfind('&');
+  if (amp == std::string_view::npos ||
+      text.find(';', text.size() - tail + amp) != std::string_view::npos)
+    return text.size();
+  return text.size() - tail + amp;
+}
+
+} // namespace FDX
+} // namespace ScreenplayTools
@@ -0,0 +1,388 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#pragma once
+
+#include "xml_entities.h"
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace ScreenplayTools {
+namespace FDX {
+
+// Where a document that arrives in parts left off at the end of one, so that
+// reading the next part carries on from there rather than going back over it.
+struct XMLResume {
+  enum class Inside {
+    Nothing,
+    Comment,
+    Instruction,
+    Declaration,
+    CDATA,
+    Tag,       // Held on to whole, as its attributes are wanted
+    SkippedTag // Only its name is kept
+  };
+  Inside inside = Inside::Nothing;
+  // How far past a held tag's '<' the search for its '>' got
+  size_t scanned = 0;
+  // The quote that was open in the tag
+  char quote = 0;
+  // A skipped tag's name, whether it's an end tag, and whether the last of it
+  // so far was the '/' of a self-closing tag
+  std::string name;
+  bool endTag = false;
+  bool slash = false;
+};
+
+// Pulls tags and text out of XML one token at a time. Tokens are views into
+// the XML, which has to outlive them; nothing is copied or allocated but the
+// name of a tag that's skipped over from one part of the XML to the next.
+//
+// It's only as strict as FDX needs. End tags aren't checked against start
+// tags, entities are left as they are for appendDecoded(), and the
+// declaration, processing instructions, comments and DOCTYPE are skipped.
+// CDATA comes out as text.
+class XMLReader {
+public:
+  enum class TokenType {
+    StartTag,   // name and attributes, and whether it's self-closing
+    EndTag,     // name
+    Text,       // text, raw, and whether it's CDATA
+    Incomplete, // The rest of the XML doesn't make a whole token, with the
+                // name of the start tag it's part of if there's one
+    End
+  };
+
+  struct Token {
+    TokenType type = TokenType::End;
+    std::string_view name;
+    // Everything between the name and the end of a start tag, for
+    // GetAttribute()
+    std::string_view attributes;
+    std::string_view text;
+    bool selfClosing = false;
+    // CDATA has no entities in it, so its text is already as it should be
+    bool cdata = false;
+  };
+
+  // If complete is false, more of the document may follow xml, so a tag cut
+  // off at its end comes back as Incomplete rather than being finished. Text
+  // at the end still comes back as Text, and its next part follows it, but
+  // never with a reference split between them. CDATA is given out in parts
+  // the same way, and comments and the like are skipped as far as they go.
+  // resume is where the previous part left off, from GetResume().
+  explicit XMLReader(std::string_view xml, bool complete = true,
+                     const XMLResume &resume = {})
+      : _xml(xml), _complete(complete), _resume(resume) {}
+
+  Token Next() {
+    Token token;
+    while (_pos < _xml.size()) {
+      if (_resume.inside == XMLResume::Inside::CDATA) {
+        if (!ReadCDATA(token))
+          return Unterminated(token);
+        if (!token.text.empty())
+          return token;
+        token = Token();
+        continue;
+      }
+      if (_resume.inside == XMLResume::Inside::SkippedTag)
+        return FinishSkippedTag(token);
+      if (_resume.inside != XMLResume::Inside::Nothing &&
+          _resume.inside != XMLResume::Inside::Tag) {
+        if (!SkipMarkup())
+          return Unterminated(token);
+        continue;
+      }
+
+      if (_xml[_pos] != '<') {
+        size_t end = _xml.find('<', _pos);
+        // Without the rest of the document, the text so far is given out
+        // as it is, so a long run of it doesn't have to be held on to
+        if (end == std::string_view::npos) {
+          end = _xml.size();
+          if (!_complete) {
+            end = _pos + decodableLength(_xml.substr(_pos));
+            if (end == _pos)
+              return Incomplete();
+          }
+        }
+        token.type = TokenType::Text;
+        token.text = _xml.substr(_pos, end - _pos);
+        _pos = end;
+        return token;
+      }
+
+      // Wait for enough to tell what sort of markup this is
+      const std::string_view rest = _xml.substr(_pos);
+      if (!_complete && (std::string_view("<![CDATA[").starts_with(rest) ||
+                         std::string_view("<!--").starts_with(rest)))
+        return Incomplete();
+
+      if (rest.starts_with("<![CDATA[")) {
+        _resume.inside = XMLResume::Inside::CDATA;
+        _pos += 9;
+      } else if (rest.starts_with("<!--")) {
+        // Markup that isn't part of the content
+        _resume.inside = XMLResume::Inside::Comment;
+        _pos += 4;
+      } else if (rest.starts_with("<?")) {
+        _resume.inside = XMLResume::Inside::Instruction;
+        _pos += 2;
+      } else if (rest.starts_with("<!")) {
+        _resume.inside = XMLResume::Inside::Declaration;
+        _pos += 2;
+      } else {
+        return ReadTag(token);
+      }
+    }
+
+    token.type = _complete ? TokenType::End : TokenType::Incomplete;
+    return token;
+  }
+
+  // How much of the XML has been read. After Incomplete, the next part of the
+  // document follows on from here, given GetResume().
+  size_t GetPosition() const { return _pos; }
+
+  // Where the XML left off, for reading the next part of the document
+  const XMLResume &GetResume() const { return _resume; }
+
+  // After a start tag comes back Incomplete with its name, drops what's been
+  // read of it. Only its name is kept, and it comes back without attributes
+  // once the rest of it has been read. End tags are always dropped this way.
+  void SkipTag(std::string_view name) { SkipTag(name, false); }
+
+  // The value of the attribute with this name, the last one if there's more
+  // than one, or nullopt if there's none.
+  static std::optional<std::string_view>
+  GetAttribute(std::string_view attributes, std::string_view name) {
+    std::optional<std::string_view> found;
+    size_t pos = 0;
+    while (true) {
+      pos = SkipWhitespace(attributes, pos);
+      if (pos >= attributes.size())
+        return found;
+
+      const size_t nameEnd = FindNameEnd(attributes, pos);
+      const std::string_view attrName =
+          attributes.substr(pos, std::max(nameEnd, pos + 1) - pos);
+      pos = SkipWhitespace(attributes, std::max(nameEnd, pos + 1));
+      if (pos >= attributes.size() || attributes[pos] != '=')
+        continue;
+
+      pos = SkipWhitespace(attributes, pos + 1);
+      if (pos >= attributes.size())
+        return found;
+      std::string_view value;
+      const char quote = attributes[pos];
+      if (quote == '"' || quote == '\'') {
+        size_t end = attributes.find(quote, pos + 1);
+        if (end == std::string_view::npos)
+          end = attributes.size();
+        value = attributes.substr(pos + 1, end - pos - 1);
+        pos = end + 1;
+      } else {
+        const size_t end = FindNameEnd(attributes, pos);
+        value = attributes.substr(pos, end - pos);
+        pos = end;
+      }
+      if (attrName == name)
+        found = value;
+    }
+  }
+
+private:
+  std::string_view _xml;
+  size_t _pos = 0;
+  bool _complete;
+  XMLResume _resume;
+  // The name of the skipped tag just given out
+  std::string _skippedName;
+
+  static bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+
+  static size_t SkipWhitespace(std::string_view xml, size_t pos) {
+    while (pos < xml.size() && IsSpace(xml[pos]))
+      pos++;
+    return pos;
+  }
+
+  // Names run up to whitespace, '=', '/' or '>'
+  static size_t FindNameEnd(std::string_view xml, size_t pos) {
+    while (pos < xml.size() && !IsSpace(xml[pos]) && xml[pos] != '=' &&
+           xml[pos] != '/' && xml[pos] != '>')
+      pos++;
+    return pos;
+  }
+
+  Token Incomplete() {
+    Token token;
+    token.type = TokenType::Incomplete;
+    return token;
+  }
+
+  // Markup that never ends runs to the end of a complete document
+  Token Unterminated(Token &token) {
+    if (!_complete)
+      return Incomplete();
+    _pos = _xml.size();
+    _resume = {};
+    token.type = TokenType::End;
+    return token;
+  }
+
+  // The text of a CDATA section up to its end, or as much of it as can't be
+  // the start of the end. Returns false if there's none to give out yet.
+  bool ReadCDATA(Token &token) {
+    size_t end = _xml.find("]]>", _pos);
+    size_t next = end + 3;
+    if (end == std::string_view::npos) {
+      if (_complete)
+        return false;
+      end = _xml.size() - std::min<size_t>(2, _xml.size() - _pos);
+      next = end;
+      if (end == _pos)
+        return false;
+    } else {
+      _resume.inside = XMLResume::Inside::Nothing;
+    }
+    token.type = TokenType::Text;
+    token.text = _xml.substr(_pos, end - _pos);
+    token.cdata = true;
+    _pos = next;
+    return true;
+  }
+
+  // Skips a comment, processing instruction or declaration up to its end.
+  // Returns false if it runs past the end of the XML, after skipping all of it
+  // that can't be the start of the end.
+  bool SkipMarkup() {
+    std::string_view close = ">";
+    if (_resume.inside == XMLResume::Inside::Comment)
+      close = "-->";
+    else if (_resume.inside == XMLResume::Inside::Instruction)
+      close = "?>";
+
+    const size_t end = _xml.find(close, _pos);
+    if (end == std::string_view::npos) {
+      _pos = _xml.size() - std::min(close.size() - 1, _xml.size() - _pos);
+      return false;
+    }
+    _pos = end + close.size();
+    _resume.inside = XMLResume::Inside::Nothing;
+    return true;
+  }
+
+  // Searches for the '>' at the end of a tag from pos, skipping over quoted
+  // attribute values. quote is the one that's open, and is left as the one
+  // that's open at the end of the XML if there's no '>'.
+  size_t FindTagEnd(size_t pos, char &quote) const {
+    while (pos < _xml.size()) {
+      if (quote) {
+        const size_t end = _xml.find(quote, pos);
+        if (end == std::string_view::npos)
+          return _xml.size();
+        quote = 0;
+        pos = end + 1;
+      } else if (_xml[pos] == '>') {
+        return pos;
+      } else {
+        if (_xml[pos] == '"' || _xml[pos] == '\'')
+          quote = _xml[pos];
+        pos++;
+      }
+    }
+    return pos;
+  }
+
+  void SkipTag(std::string_view name, bool endTag) {
+    const char quote = _resume.quote;
+    _resume = {};
+    _resume.inside = XMLResume::Inside::SkippedTag;
+    _resume.name = name;
+    _resume.endTag = endTag;
+    _resume.quote = quote;
+    _resume.slash = !quote && _xml.ends_with('/');
+    _pos = _xml.size();
+  }
+
+  Token FinishSkippedTag(Token &token) {
+    char quote = _resume.quote;
+    const size_t end = FindTagEnd(_pos, quote);
+    if (end >= _xml.size() && !_complete) {
+      _resume.quote = quote;
+      if (end > _pos)
+        _resume.slash = !quote && _xml[end - 1] == '/';
+      _pos = _xml.size();
+      return Incomplete();
+    }
+
+    _skippedName = std::move(_resume.name);
+    token.type = _resume.endTag ? TokenType::EndTag : TokenType::StartTag;
+    token.name = _skippedName;
+    token.selfClosing = end > _pos ? _xml[end - 1] == '/' : _resume.slash;
+    _resume = {};
+    _pos = std::min(end + 1, _xml.size());
+    return token;
+  }
+
+  Token ReadTag(Token &token) {
+    size_t pos = _pos + 1;
+    const bool endTag = pos < _xml.size() && _xml[pos] == '/';
+    if (endTag)
+      pos++;
+
+    const size_t nameEnd = FindNameEnd(_xml, pos);
+    token.name = _xml.substr(pos, nameEnd - pos);
+    pos = nameEnd;
+
+    // A tag cut off by the end of the last part picks up where the search for
+    // its end got to
+    const size_t attributesStart = pos;
+    char quote = 0;
+    if (_resume.inside == XMLResume::Inside::Tag) {
+      pos = std::max(pos, _pos + _resume.scanned);
+      quote = _resume.quote;
+    }
+    pos = FindTagEnd(pos, quote);
+    if (pos >= _xml.size()) {
+      if (!_complete) {
+        _resume = {};
+        _resume.inside = XMLResume::Inside::Tag;
+        _resume.scanned = pos - _pos;
+        _resume.quote = quote;
+        // Its name is only known once something follows it
+        if (nameEnd >= _xml.size())
+          return Incomplete();
+        if (endTag) {
+          SkipTag(token.name, true);
+          return Incomplete();
+        }
+        Token cutOff = Incomplete();
+        cutOff.name = token.name;
+        return cutOff;
+      }
+      pos = _xml.size();
+    }
+    _resume = {};
+
+    std::string_view attributes =
+        _xml.substr(attributesStart, pos - attributesStart);
+    if (attributes.ends_with('/')) {
+      token.selfClosing = true;
+      attributes.remove_suffix(1);
+    }
+    token.type = endTag ? TokenType::EndTag : TokenType::StartTag;
+    token.attributes = endTag ? std::string_view() : attributes;
+    _pos = std::min(pos + 1, _xml.size());
+    return token;
+  }
+};
+
+} // namespace FDX
+} // namespace ScreenplayTools
@@ -9,13 +9,13 @@
 namespace ScreenplayTools {
 namespace Fountain {
 
-CallbackParser::CallbackParser() : _lastChar(nullptr), _lastParen(nullptr) {
+CallbackParser::CallbackParser() {
   mergeActions = false;  // Don't merge actions, callbacks need them separated.
   mergeDialogue = false; // Don't merge dialogue, callbacks need them separated.
 }
 
-void CallbackParser::addLine(const std::string &inputLine) {
-  int elementCount = _script->getElements().size();
+void CallbackParser::addLine(std::string_view inputLine) {
+  size_t elementCount = _script->getElements().size();
   bool wasInTitlePage = _inTitlePage;
 
   Parser::addLine(inputLine);
@@ -31,99 +31,88 @@ void CallbackParser::addLine(const std::string &inputLine) {
     }
   }
 
-  while (elementCount < _script->getElements().size()) {
-    _handleNewElement(_script->getElements()[elementCount]);
-    elementCount++;
-  }
-}
-
-void CallbackParser::_handleNewElement(const std::shared_ptr<Element> &elem) {
-  switch (elem->getType()) {
-  case ElementType::CHARACTER:
-    _lastChar = std::dynamic_pointer_cast<Character>(elem);
-    break;
-
-  case ElementType::PARENTHETICAL:
-    _lastParen = std::dynamic_pointer_cast<Parenthetical>(elem);
-    break;
-
-  case ElementType::DIALOGUE:
-    if (_lastChar) {
-
-      std::string name = _lastChar->getName();
-      std::optional<std::string> extension = _lastChar->getExtension();
-      std::optional<std::string> parenthetical =
-          _lastParen ? std::optional<std::string>(_lastParen->getTextRaw())
-                     : std::nullopt;
-      std::string line = elem->getTextRaw();
-      bool isDualDialogue = _lastChar->isDualDialogue();
-
-      _lastParen = nullptr;
-
-      if (ignoreBlanks && isWhitespaceOrEmpty(line))
-        return;
-
-      if (onDialogue)
-        onDialogue(name, extension, parenthetical, line, isDualDialogue);
-    }
-    break;
-
-  case ElementType::ACTION:
-    if (ignoreBlanks && isWhitespaceOrEmpty(elem->getTextRaw()))
-      return;
+  const auto &elements = _script->getElements();
+  for (; elementCount < elements.size(); elementCount++)
+    _handleNewElement(*elements[elementCount]);
 
-    if (onAction)
-      onAction(elem->getTextRaw());
-    break;
-
-  case ElementType::HEADING:
-    if (ignoreBlanks && isWhitespaceOrEmpty(elem->getTextRaw()))
-      return;
-
-    if (onSceneHeading) {
-      auto heading = std::dynamic_pointer_cast<SceneHeading>(elem);
-      onSceneHeading(heading->getTextRaw(), heading->getSceneNumber());
-    }
-    break;
-
-  case ElementType::LYRIC:
-    if (ignoreBlanks && isWhitespaceOrEmpty(elem->getTextRaw()))
-      return;
-
-    if (onLyrics)
-      onLyrics(elem->getTextRaw());
-    break;
-
-  case ElementType::TRANSITION:
-    if (ignoreBlanks && isWhitespaceOrEmpty(elem->getTextRaw()))
-      return;
-
-    if (onTransition)
-      onTransition(elem->getTextRaw());
-    break;
+  if (streaming)
+    _discardParsed();
+}
 
-  case ElementType::SECTION:
-    if (onSection) {
-      auto section = std::dynamic_pointer_cast<Section>(elem);
-      onSection(section->getTextRaw(), section->getLevel());
-    }
-    break;
-
-  case ElementType::SYNOPSIS:
-    if (onSynopsis)
-      onSynopsis(elem->getTextRaw());
-    break;
-
-  case ElementType::PAGEBREAK:
-    if (onPageBreak)
-      onPageBreak();
-    break;
-
-  default:
-    _lastChar = nullptr;
-    _lastParen = nullptr;
-    break;
-  }
+void CallbackParser::_handleNewElement(const Element &elem) {
+  // Whether to skip an element because it's blank
+  auto blank = [this](const Element &e) {
+    return ignoreBlanks && isWhitespaceOrEmpty(e.getTextRaw());
+  };
+
+  auto handle = overloaded{
+      [this](const Character &e) {
+        // Assigned field by field so the strings' buffers get reused
+        if (!_lastChar)
+          _lastChar.emplace();
+        _lastChar->name = e.getName();
+        _lastChar->extension = e.getExtension();
+        _lastChar->dual = e.isDualDialogue();
+      },
+
+      [this](const Parenthetical &e) { _lastParen = e.getTextRaw(); },
+
+      [&](const Dialogue &e) {
+        if (!_lastChar)
+          return;
+
+        std::optional<std::string> parenthetical = std::move(_lastParen);
+        _lastParen.reset();
+
+        if (blank(e))
+          return;
+
+        if (onDialogue)
+          onDialogue(_lastChar->name, _lastChar->extension, parenthetical,
+                     e.getTextRaw(), _lastChar->dual);
+      },
+
+      [&](const Action &e) {
+        if (!blank(e) && onAction)
+          onAction(e.getTextRaw());
+      },
+
+      [&](const SceneHeading &e) {
+        if (!blank(e) && onSceneHeading)
+          onSceneHeading(e.getTextRaw(), e.getSceneNumber());
+      },
+
+      [&](const Lyric &e) {
+        if (!blank(e) && onLyrics)
+          onLyrics(e.getTextRaw());
+      },
+
+      [&](const Transition &e) {
+        if (!blank(e) && onTransition)
+          onTransition(e.getTextRaw());
+      },
+
+      [this](const Section &e) {
+        if (onSection)
+          onSection(e.getTextRaw(), e.getLevel());
+      },
+
+      [this](const Synopsis &e) {
+        if (onSynopsis)
+          onSynopsis(e.getTextRaw());
+      },
+
+      [this](const PageBreak &) {
+        if (onPageBreak)
+          onPageBreak();
+      },
+
+      [this](const Element &) {
+        _lastChar.reset();
+        _lastParen.reset();
+      }};
+
+  visit(elem, handle);
 } // namespace ScreenplayTools
 } // namespace Fountain
 
@@ -0,0 +1,587 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "screenplay_tools/fountain/incremental_parser.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace ScreenplayTools {
+namespace Fountain {
+
+namespace {
+
+// Copies an element as it was when its raw text was textLength long and it had
+// tagCount tags.
+std::unique_ptr<Element> copyElementPrefix(const Element &element,
+                                           size_t textLength, size_t tagCount) {
+  std::string text = element.getTextRaw().substr(0, textLength);
+  std::unique_ptr<Element> copy;
+
+  switch (element.getType()) {
+  case ElementType::TITLEENTRY:
+    copy = std::make_unique<TitleEntry>(
+        static_cast<const TitleEntry &>(element).getKey(), text);
+    break;
+  case ElementType::ACTION: {
+    const auto &action = static_cast<const Action &>(element);
+    auto newAction = std::make_unique<Action>(text, action.isForced());
+    newAction->setCentered(action.isCentered());
+    copy = std::move(newAction);
+    break;
+  }
+  case ElementType::HEADING: {
+    const auto &heading = static_cast<const SceneHeading &>(element);
+    copy = std::make_unique<SceneHeading>(text, heading.getSceneNumber(),
+                                          heading.isForced());
+    break;
+  }
+  case ElementType::CHARACTER: {
+    const auto &character = static_cast<const Character &>(element);
+    copy = std::make_unique<Character>(
+        character.getName(), character.getExtension(),
+        character.isDualDialogue(), character.isForced());
+    break;
+  }
+  case ElementType::DIALOGUE:
+    copy = std::make_unique<Dialogue>(text);
+    break;
+  case ElementType::PARENTHETICAL:
+    copy = std::make_unique<Parenthetical>(text);
+    break;
+  case ElementType::LYRIC:
+    copy = std::make_unique<Lyric>(text);
+    break;
+  case ElementType::TRANSITION:
+    copy = std::make_unique<Transition>(
+        text, static_cast<const Transition &>(element).isForced());
+    break;
+  case ElementType::PAGEBREAK:
+    copy = std::make_unique<PageBreak>();
+    break;
+  case ElementType::SECTION:
+    copy = std::make_unique<Section>(
+        text, static_cast<const Section &>(element).getLevel());
+    break;
+  case ElementType::SYNOPSIS:
+    copy = std::make_unique<Synopsis>(text);
+    break;
+  case ElementType::NOTE:
+    copy = std::make_unique<Note>(text);
+    break;
+  case ElementType::BONEYARD:
+    copy = std::make_unique<Boneyard>(text);
+    break;
+  }
+
+  const auto &tags = element.getTagIds();
+  copy->appendTags(std::vector<TagId>(tags.begin(), tags.begin() + tagCount));
+  return copy;
+}
+
+// Is element the same as other was when its raw text was textLength long and
+// it had tagCount tags?
+bool matchesElementPrefix(const Element &element, const Element &other,
+                          size_t textLength, size_t tagCount) {
+  if (element.getType() != other.getType())
+    return false;
+
+  std::string_view otherText = other.getTextRaw();
+  if (element.getTextRaw() != otherText.substr(0, textLength))
+    return false;
+
+  const auto &tags = element.getTagIds();
+  const auto &otherTags = other.getTagIds();
+  if (tags.size() != tagCount || otherTags.size() < tagCount ||
+      !std::equal(tags.begin(), tags.end(), otherTags.begin()))
+    return false;
+
+  switch (element.getType()) {
+  case ElementType::TITLEENTRY:
+    return static_cast<const TitleEntry &>(element).getKey() ==
+           static_cast<const TitleEntry &>(other).getKey();
+  case ElementType::ACTION: {
+    const auto &a = static_cast<const Action &>(element);
+    const auto &b = static_cast<const Action &>(other);
+    return a.isForced() == b.isForced() && a.isCentered() == b.isCentered();
+  }
+  case ElementType::HEADING: {
+    const auto &a = static_cast<const SceneHeading &>(element);
+    const auto &b = static_cast<const SceneHeading &>(other);
+    return a.getSceneNumber() == b.getSceneNumber() &&
+           a.isForced() == b.isForced();
+  }
+  case ElementType::CHARACTER: {
+    const auto &a = static_cast<const Character &>(element);
+    const auto &b = static_cast<const Character &>(other);
+    return a.getName() == b.getName() && a.getExtension() == b.getExtension() &&
+           a.isDualDialogue() == b.isDualDialogue() &&
+           a.isForced() == b.isForced();
+  }
+  case ElementType::TRANSITION:
+    return static_cast<const Transition &>(element).isForced() ==
+           static_cast<const Transition &>(other).isForced();
+  case ElementType::SECTION:
+    return static_cast<const Section &>(element).getLevel() ==
+           static_cast<const Section &>(other).getLevel();
+  default:
+    return true;
+  }
+}
+
+} // namespace
+
+IncrementalParser::IncrementalParser() {
+  // Replaced elements should be freed rather than pile up in an arena.
+  _script = std::make_shared<Script>(false);
+  _script->_noteNewTags = true;
+}
+
+void IncrementalParser::setText(std::string_view text) {
+  std::vector<std::string> lines;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    if (end == std::string_view::npos)
+      end = text.size();
+
+    std::string_view line = text.substr(start, end - start);
+    if (line.ends_with('\r'))
+      line.remove_suffix(1);
+
+    lines.emplace_back(line);
+    start = end + 1;
+  }
+
+  _lineBlocks.clear();
+  _lineCount = 0;
+  replaceLines(0, 0, std::move(lines));
+}
+
+IncrementalParser::EditWork
+IncrementalParser::replaceLines(size_t firstLine, size_t removeCount,
+                                std::vector<std::string> newLines) {
+  if (firstLine > _lineCount)
+    throw std::out_of_range("Line " + std::to_string(firstLine) +
+                            " is past the end of the document");
+  removeCount = std::min(removeCount, _lineCount - firstLine);
+
+  // Resume after the last usable checkpoint before the edit, or from the
+  // start of the document, where the state holds no tags.
+  size_t resumeLine = firstLine;
+  const Checkpoint *resume = nullptr;
+  for (; resumeLine > 0; resumeLine--) {
+    const auto &checkpoint = _line(resumeLine - 1).checkpoint;
+    if (checkpoint && !_isStale(*checkpoint)) {
+      resume = checkpoint.get();
+      break;
+    }
+  }
+
+  // Checkpoints from the end of the edit on still describe the previous parse
+  // of the lines they're on. They're how we tell when the new parse has caught
+  // up. The one on the last line removed describes where the new lines end.
+  std::unique_ptr<Checkpoint> boundary;
+  if (removeCount > 0)
+    boundary = std::move(_line(firstLine + removeCount - 1).checkpoint);
+
+  Script &script = *_script;
+  Element *const resumeLast = resume ? resume->last : nullptr;
+  const size_t kept =
+      resumeLast ? script._elements.positionOf(*resumeLast) : 0;
+  const size_t firstNote = resume ? resume->noteCount : 0;
+  const size_t firstBoneyard = resume ? resume->boneyardCount : 0;
+  const std::optional<CueId> oldLastCue = script._lastCue;
+
+  // Elements that are dropped for good stop counting towards their cue, and
+  // their tags may not be used any more
+  std::vector<TagId> droppedTags;
+  auto drop = [&](const Element &element) {
+    if (element.getType() == ElementType::CHARACTER)
+      script._releaseCue(static_cast<const Character &>(element).getCueId());
+    const auto &tags = element.getTagIds();
+    droppedTags.insert(droppedTags.end(), tags.begin(), tags.end());
+  };
+  auto dropElements = [&](size_t from, size_t to) {
+    auto it = script._elements._iteratorAt(from);
+    for (size_t i = from; i < to; i++, ++it)
+      drop(**it);
+  };
+  if (!resume) {
+    for (const auto &titleEntry : script._titleEntries)
+      drop(*titleEntry);
+  }
+
+  // The new parse goes into lists of its own, starting with a copy of how the
+  // last element was at the checkpoint, as later lines may have been appended
+  // to it. Once it's known which of the previous parse's elements it stands
+  // for, it takes their place.
+  ElementList elements = std::move(script._elements);
+  std::vector<std::shared_ptr<Note>> notes = std::move(script._notes);
+  std::vector<std::shared_ptr<Boneyard>> boneyards =
+      std::move(script._boneyards);
+  script._notes.clear();
+  script._boneyards.clear();
+  script._keepIndexes = false;
+  _restore(resume);
+
+  const size_t editEnd = firstLine + newLines.size();
+  _spliceLines(firstLine, removeCount, std::move(newLines));
+
+  // The checkpoint that says how the previous parse stood after the given
+  // number of lines, if it's one the new parse has come back in line with
+  auto caughtUp = [&](size_t line) -> Checkpoint * {
+    if (line < editEnd || !_isSafePoint())
+      return nullptr;
+    Checkpoint *old =
+        line == editEnd ? boundary.get() : _line(line - 1).checkpoint.get();
+    return old && !_isStale(*old) && _matches(*old) ? old : nullptr;
+  };
+
+  size_t line = resumeLine;
+  size_t sinceCheckpoint = 0;
+  Checkpoint *old = caughtUp(line);
+  while (!old && line < _lineCount) {
+    Parser::addLine(_line(line).text);
+    line++;
+
+    old = caughtUp(line);
+    if (old)
+      break;
+
+    auto &checkpoint = _line(line - 1).checkpoint;
+    if (++sinceCheckpoint >= checkpointInterval && _isSafePoint()) {
+      checkpoint = std::make_unique<Checkpoint>(_makeCheckpoint());
+      sinceCheckpoint = 0;
+    } else {
+      checkpoint.reset();
+    }
+  }
+  if (!old)
+    finalizeParsing();
+
+  ElementList parsed = std::move(script._elements);
+  std::vector<std::shared_ptr<Note>> parsedNotes = std::move(script._notes);
+  std::vector<std::shared_ptr<Boneyard>> parsedBoneyards =
+      std::move(script._boneyards);
+  script._elements = std::move(elements);
+  script._notes = std::move(notes);
+  script._boneyards = std::move(boneyards);
+  script._keepIndexes = true;
+  _discardedNotes = 0;
+  _discardedBoneyards = 0;
+
+  EditWork work;
+  work.lines = line - resumeLine;
+
+  // Our version of the last element when the parse caught up, which the
+  // previous parse's stands in for
+  Element *parsedLast = nullptr;
+  std::shared_ptr<Element> parsedLastOwner;
+
+  if (old) {
+    // Caught up: the rest of the previous parse applies unchanged. The notes
+    // and boneyards came out the same in number, so ours take the places of
+    // the ones they replace.
+    const size_t end =
+        old->last ? script._elements.positionOf(*old->last) : 0;
+    if (!parsed.empty()) {
+      parsedLast = parsed.back();
+      drop(*parsedLast);
+      parsedLastOwner = parsed.pop_back();
+    }
+    dropElements(kept, end);
+    std::move(parsedNotes.begin(), parsedNotes.end(),
+              script._notes.begin() + firstNote);
+    std::move(parsedBoneyards.begin(), parsedBoneyards.end(),
+              script._boneyards.begin() + firstBoneyard);
+    script._lastCue = oldLastCue;
+    work.elements = script._replaceElements(kept, end - kept, parsed);
+
+    if (old == boundary.get())
+      _line(line - 1).checkpoint = std::move(boundary);
+  } else {
+    dropElements(kept, script._elements.size());
+    script._notes.resize(firstNote);
+    script._notes.insert(script._notes.end(),
+                         std::make_move_iterator(parsedNotes.begin()),
+                         std::make_move_iterator(parsedNotes.end()));
+    script._boneyards.resize(firstBoneyard);
+    script._boneyards.insert(script._boneyards.end(),
+                             std::make_move_iterator(parsedBoneyards.begin()),
+                             std::make_move_iterator(parsedBoneyards.end()));
+    work.elements = script._replaceElements(
+        kept, script._elements.size() - kept, parsed);
+
+    // Lines at the end whose tags haven't gone anywhere yet
+    droppedTags.insert(droppedTags.end(), _trailingTags.begin(),
+                       _trailingTags.end());
+    _trailingTags.clear();
+    auto keepTags = [&](const std::vector<TagId> &tags) {
+      _trailingTags.insert(_trailingTags.end(), tags.begin(), tags.end());
+    };
+    for (const auto &padAction : _padActions)
+      keepTags(padAction.getTagIds());
+    for (auto &pendingItem : _pending) {
+      keepTags(pendingItem.element().getTagIds());
+      keepTags(pendingItem.backup.getTagIds());
+    }
+    keepTags(_lineTags);
+  }
+
+  // Checkpoints on the re-parsed lines that had our version of the last
+  // element have the previous parse's instead. Earlier ones that had the
+  // element the parse resumed from, which may since have been replaced, have
+  // whatever now starts where it was: the copy of it, or what the copy
+  // turned out to be the start of.
+  if (parsedLast) {
+    for (size_t i = resumeLine; i + 1 < line; i++) {
+      auto &checkpoint = _line(i).checkpoint;
+      if (checkpoint && checkpoint->last == parsedLast)
+        checkpoint->last = old->last;
+    }
+  }
+  if (resumeLast) {
+    Element *replacement = script._elements[kept];
+    for (size_t i = resumeLine; i-- > 0;) {
+      auto &checkpoint = _line(i).checkpoint;
+      if (!checkpoint)
+        continue;
+      if (checkpoint->last != resumeLast)
+        break;
+      checkpoint->last = replacement;
+    }
+  }
+
+  _releaseUnusedTags(droppedTags);
+  return work;
+}
+
+size_t IncrementalParser::_lineBlockIndex(size_t line) const {
+  auto it = std::upper_bound(_lineBlocks.begin(), _lineBlocks.end(), line,
+                             [](size_t line, const LineBlock &block) {
+                               return line < block.start;
+                             });
+  return std::prev(it) - _lineBlocks.begin();
+}
+
+IncrementalParser::Line &IncrementalParser::_line(size_t line) {
+  LineBlock &block = _lineBlocks[_lineBlockIndex(line)];
+  return block.lines[line - block.start];
+}
+
+const IncrementalParser::Line &IncrementalParser::_line(size_t line) const {
+  const LineBlock &block = _lineBlocks[_lineBlockIndex(line)];
+  return block.lines[line - block.start];
+}
+
+void IncrementalParser::_spliceLines(size_t first, size_t count,
+                                     std::vector<std::string> newLines) {
+  if (_lineBlocks.empty())
+    _lineBlocks.emplace_back();
+
+  std::vector<Line> lines;
+  lines.reserve(newLines.size());
+  for (std::string &text : newLines)
+    lines.push_back({std::move(text), nullptr});
+
+  // Blocks from b to e hold the lines being replaced, or the place where the
+  // new ones go
+  const size_t b = _lineBlockIndex(first);
+  const size_t e = count > 0 ? _lineBlockIndex(first + count - 1) : b;
+  const size_t head = first - _lineBlocks[b].start;
+  size_t next;
+
+  if (b == e && _lineBlocks[b].lines.size() - count + lines.size() <=
+                    2 * _lineBlockSize) {
+    std::vector<Line> &blockLines = _lineBlocks[b].lines;
+    auto at = blockLines.erase(blockLines.begin() + head,
+                               blockLines.begin() + head + count);
+    blockLines.insert(at, std::make_move_iterator(lines.begin()),
+                      std::make_move_iterator(lines.end()));
+    next = b + 1;
+  } else {
+    // Gather what's kept of the blocks around the new lines and deal the lot
+    // out over as many blocks as it needs
+    std::vector<Line> run;
+    std::vector<Line> &firstLines = _lineBlocks[b].lines;
+    std::vector<Line> &lastLines = _lineBlocks[e].lines;
+    const size_t tail = first + count - _lineBlocks[e].start;
+    run.reserve(head + lines.size() + lastLines.size() - tail);
+    run.insert(run.end(), std::make_move_iterator(firstLines.begin()),
+               std::make_move_iterator(firstLines.begin() + head));
+    run.insert(run.end(), std::make_move_iterator(lines.begin()),
+               std::make_move_iterator(lines.end()));
+    run.insert(run.end(), std::make_move_iterator(lastLines.begin() + tail),
+               std::make_move_iterator(lastLines.end()));
+
+    std::vector<LineBlock> blocks(
+        std::max<size_t>(run.size() / _lineBlockSize, 1));
+    for (size_t k = 0; k < blocks.size(); k++) {
+      const size_t from = k * run.size() / blocks.size();
+      const size_t to = (k + 1) * run.size() / blocks.size();
+      blocks[k].lines.assign(std::make_move_iterator(run.begin() + from),
+                             std::make_move_iterator(run.begin() + to));
+      blocks[k].start = _lineBlocks[b].start + from;
+    }
+    _lineBlocks.erase(_lineBlocks.begin() + b, _lineBlocks.begin() + e + 1);
+    _lineBlocks.insert(_lineBlocks.begin() + b,
+                       std::make_move_iterator(blocks.begin()),
+                       std::make_move_iterator(blocks.end()));
+    next = b + blocks.size();
+  }
+
+  _lineCount = _lineCount - count + newLines.size();
+  for (size_t k = next; k < _lineBlocks.size(); k++) {
+    const LineBlock &previous = _lineBlocks[k - 1];
+    _lineBlocks[k].start = previous.start + previous.lines.size();
+  }
+}
+
+void IncrementalParser::_reset() {
+  // Start over from a fresh parser's state, keeping the script and options.
+  std::shared_ptr<Script> script = _script;
+  const bool actions = mergeActions;
+  const bool dialogue = mergeDialogue;
+  const bool tags = useTags;
+
+  static_cast<Parser &>(*this) = Parser();
+
+  _script = script;
+  mergeActions = actions;
+  mergeDialogue = dialogue;
+  useTags = tags;
+}
+
+void IncrementalParser::_releaseUnusedTags(std::vector<TagId> &tags) {
+  Script &script = *_script;
+  tags.insert(tags.end(), script._newTags.begin(), script._newTags.end());
+  script._newTags.clear();
+  std::sort(tags.begin(), tags.end());
+  tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+
+  for (TagId tag : tags) {
+    if (script._isTagUsed(tag) ||
+        std::find(_trailingTags.begin(), _trailingTags.end(), tag) !=
+            _trailingTags.end())
+      continue;
+    script._tags.release(tag);
+    if (tag >= _tagReleases.size())
+      _tagReleases.resize(tag + 1);
+    _tagReleases[tag] = ++_releaseCount;
+  }
+}
+
+bool IncrementalParser::_isStale(const Checkpoint &checkpoint) const {
+  auto released = [&](const std::vector<TagId> &tags) {
+    return std::any_of(tags.begin(), tags.end(), [&](TagId tag) {
+      return tag < _tagReleases.size() &&
+             _tagReleases[tag] > checkpoint.releaseCount;
+    });
+  };
+  return released(checkpoint.lineTags) ||
+         std::any_of(checkpoint.padActionTags.begin(),
+                     checkpoint.padActionTags.end(), released);
+}
+
+bool IncrementalParser::_isSafePoint() const {
+  return !_inTitlePage && !_currentBoneyard && !_currentNote &&
+         _pending.empty();
+}
+
+IncrementalParser::Checkpoint IncrementalParser::_makeCheckpoint() const {
+  const Script &script = *_script;
+
+  Checkpoint checkpoint;
+  checkpoint.noteCount = _discardedNotes + script._notes.size();
+  checkpoint.boneyardCount = _discardedBoneyards + script._boneyards.size();
+  if (!script._elements.empty()) {
+    checkpoint.last = script._elements.back();
+    checkpoint.lastTextLength = checkpoint.last->getTextRaw().size();
+    checkpoint.lastTagCount = checkpoint.last->getTagIds().size();
+  }
+  for (const auto &padAction : _padActions) {
+    checkpoint.padActions.push_back(padAction.getTextRaw());
+    checkpoint.padActionTags.push_back(padAction.getTagIds());
+  }
+  checkpoint.lineTags = _lineTags;
+  checkpoint.releaseCount = _releaseCount;
+  checkpoint.lastCue = script._lastCue;
+  checkpoint.lastLineWhitespaceOrEmpty = _lastLineWhitespaceOrEmpty;
+  checkpoint.lastLineEmpty = _lastLineEmpty;
+  checkpoint.inDialogue = _inDialogue;
+  return checkpoint;
+}
+
+void IncrementalParser::_restore(const Checkpoint *checkpoint) {
+  _reset();
+
+  Script &script = *_script;
+  if (!checkpoint) {
+    script._titleEntries.clear();
+    script._lastCue.reset();
+    return;
+  }
+
+  // Checkpoints are only taken once the title page is over.
+  _inTitlePage = false;
+  // Notes and boneyards before the checkpoint keep their ids
+  _discardedNotes = checkpoint->noteCount;
+  _discardedBoneyards = checkpoint->boneyardCount;
+
+  if (checkpoint->last) {
+    Element *copy = script._pushElement(std::move(*copyElementPrefix(
+        *checkpoint->last, checkpoint->lastTextLength,
+        checkpoint->lastTagCount)));
+    if (copy->getType() == ElementType::CHARACTER) {
+      auto &character = static_cast<Character &>(*copy);
+      script._internCue(character);
+      script._useCue(character.getCueId());
+    }
+  }
+  for (size_t i = 0; i < checkpoint->padActions.size(); i++) {
+    _padActions.emplace_back(checkpoint->padActions[i]);
+    _padActions.back().appendTags(checkpoint->padActionTags[i]);
+  }
+  _lineTags = checkpoint->lineTags;
+  script._lastCue = checkpoint->lastCue;
+  _lastLineWhitespaceOrEmpty = checkpoint->lastLineWhitespaceOrEmpty;
+  _lastLineEmpty = checkpoint->lastLineEmpty;
+  _inDialogue = checkpoint->inDialogue;
+}
+
+bool IncrementalParser::_matches(const Checkpoint &checkpoint) const {
+  const Script &script = *_script;
+
+  // Notes and boneyards are referred to by index in element text, so the
+  // counts have to agree for the rest of the text to be the same.
+  if (_discardedNotes + script._notes.size() != checkpoint.noteCount ||
+      _discardedBoneyards + script._boneyards.size() !=
+          checkpoint.boneyardCount)
+    return false;
+
+  if (_lastLineWhitespaceOrEmpty != checkpoint.lastLineWhitespaceOrEmpty ||
+      _lastLineEmpty != checkpoint.lastLineEmpty ||
+      _inDialogue != checkpoint.inDialogue ||
+      _lineTags != checkpoint.lineTags ||
+      script._lastCue != checkpoint.lastCue)
+    return false;
+
+  if (_padActions.size() != checkpoint.padActions.size())
+    return false;
+  for (size_t i = 0; i < _padActions.size(); i++) {
+    if (_padActions[i].getTextRaw() != checkpoint.padActions[i] ||
+        _padActions[i].getTagIds() != checkpoint.padActionTags[i])
+      return false;
+  }
+
+  if (script._elements.empty() || !checkpoint.last)
+    return script._elements.empty() && !checkpoint.last;
+
+  return matchesElementPrefix(*script._elements.back(), *checkpoint.last,
+                              checkpoint.lastTextLength,
+                              checkpoint.lastTagCount);
+}
+
+} // namespace Fountain
+} // namespace ScreenplayTools
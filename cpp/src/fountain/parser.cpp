@@ -2,25 +2,591 @@
 // for details. Copyright (c) 2024 Ian Thomas
 
 #include "screenplay_tools/fountain/parser.h"
+#include "../mapped_file.h"
 #include "screenplay_tools/utils.h"
-#include <regex>
-#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+#include <thread>
+
+#ifdef SCREENPLAY_TOOLS_PARSE_STATS
+#include <chrono>
+#include <type_traits>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace ScreenplayTools {
 namespace Fountain {
 
+// Hand-written line matchers. Each one reproduces the classification (and
+// captures) of the std::regex pattern quoted above it, including the
+// ECMAScript rules that \s covers " \t\n\v\f\r" and that '.' does not
+// match '\n' or '\r'.
+namespace {
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
+         c == '\r';
+}
+
+bool isUpper(char c) { return c >= 'A' && c <= 'Z'; }
+
+bool isLower(char c) { return c >= 'a' && c <= 'z'; }
+
+bool isAlnum(char c) {
+  return isUpper(c) || isLower(c) || (c >= '0' && c <= '9');
+}
+
+char toLower(char c) { return isUpper(c) ? c - 'A' + 'a' : c; }
+
+bool hasLineTerminator(std::string_view str) {
+  return str.find_first_of("\r\n") != std::string_view::npos;
+}
+
+size_t firstNonSpace(std::string_view str, size_t pos = 0) {
+  while (pos < str.size() && isSpace(str[pos]))
+    pos++;
+  return pos;
+}
+
+// Index one past the last non-space character at or before end.
+size_t endNonSpace(std::string_view str, size_t end) {
+  while (end > 0 && isSpace(str[end - 1]))
+    end--;
+  return end;
+}
+
+bool startsWithNoCase(std::string_view str, size_t pos,
+                      std::string_view prefix) {
+  if (str.size() - pos < prefix.size())
+    return false;
+  for (size_t i = 0; i < prefix.size(); i++) {
+    if (toLower(str[pos + i]) != prefix[i])
+      return false;
+  }
+  return true;
+}
+
+// ^\s*([A-Za-z0-9 ]+?)\s*:\s*(.*?)\s*$
+bool matchTitleEntry(std::string_view line, std::string_view &key,
+                     std::string_view &value) {
+  size_t colon = line.find(':');
+  if (colon == std::string_view::npos)
+    return false;
+
+  size_t keyStart = firstNonSpace(line);
+  if (keyStart >= colon) {
+    // All whitespace before the colon; the key can only be a single space.
+    size_t space = line.rfind(' ', colon);
+    if (space == std::string_view::npos)
+      return false;
+    key = line.substr(space, 1);
+  } else {
+    size_t keyEnd = endNonSpace(line, colon);
+    key = line.substr(keyStart, keyEnd - keyStart);
+    for (char c : key) {
+      if (!isAlnum(c) && c != ' ')
+        return false;
+    }
+  }
+
+  size_t valueStart = firstNonSpace(line, colon + 1);
+  size_t valueEnd = std::max(endNonSpace(line, line.size()), valueStart);
+  value = line.substr(valueStart, valueEnd - valueStart);
+  return !hasLineTerminator(value);
+}
+
+// ^( {3,}|\t)
+bool matchTitleContinuation(std::string_view line) {
+  return line.starts_with("   ") || line.starts_with('\t');
+}
+
+// ^=(?!\=)
+bool matchSynopsis(std::string_view line) {
+  return line.starts_with('=') && !line.starts_with("==");
+}
+
+// ^\.[a-zA-Z0-9]
+bool matchForcedSceneHeading(std::string_view line) {
+  return line.size() > 1 && line[0] == '.' && isAlnum(line[1]);
+}
+
+// (.*?)(?:\s*#([a-zA-Z0-9\-.]+?)#)?
+bool matchSceneNumber(std::string_view line, std::string_view &text,
+                      std::optional<std::string_view> &sceneNumber) {
+  text = line;
+  sceneNumber = std::nullopt;
+
+  if (line.size() >= 3 && line.back() == '#') {
+    size_t open = line.size() - 1;
+    while (open > 0 && (isAlnum(line[open - 1]) || line[open - 1] == '-' ||
+                        line[open - 1] == '.')) {
+      open--;
+    }
+    if (open > 0 && open < line.size() - 1 && line[open - 1] == '#') {
+      sceneNumber = line.substr(open, line.size() - 1 - open);
+      text = line.substr(0, endNonSpace(line, open - 1));
+    }
+  }
+  return !hasLineTerminator(text);
+}
+
+// ^\s*((INT|EXT|EST|INT\.\/EXT|INT\/EXT|I\/E)(\.|\s))|(FADE IN:\s*)
+// (case-insensitive)
+bool matchSceneHeading(std::string_view line) {
+  size_t pos = firstNonSpace(line);
+  for (std::string_view prefix : {"int", "ext", "est", "int/ext", "i/e"}) {
+    if (startsWithNoCase(line, pos, prefix) &&
+        pos + prefix.size() < line.size()) {
+      char next = line[pos + prefix.size()];
+      if (next == '.' || isSpace(next))
+        return true;
+    }
+  }
+
+  // The FADE IN: alternative isn't anchored, so it can appear anywhere.
+  for (size_t i = 0; i < line.size(); i++) {
+    if (startsWithNoCase(line, i, "fade in:"))
+      return true;
+  }
+  return false;
+}
+
+// ^\s*(?:[A-Z\s]+TO:)\s*$
+bool matchTransition(std::string_view line) {
+  size_t end = endNonSpace(line, line.size());
+  if (end < 4 || line.substr(end - 3, 3) != "TO:")
+    return false;
+  for (size_t i = 0; i < end - 3; i++) {
+    if (!isUpper(line[i]) && !isSpace(line[i]))
+      return false;
+  }
+  return true;
+}
+
+// ^\s*\((.*)\)\s*$
+bool matchParenthetical(std::string_view line, std::string_view &inner) {
+  size_t open = firstNonSpace(line);
+  size_t end = endNonSpace(line, line.size());
+  if (open >= line.size() || line[open] != '(' || end < open + 2 ||
+      line[end - 1] != ')')
+    return false;
+  inner = line.substr(open + 1, end - open - 2);
+  return !hasLineTerminator(inner);
+}
+
+// Position of the ')' that closes an extension in a character cue, given the
+// cue must end (\(.*\))?(?:\s*\^\s*)?$. There is at most one candidate.
+size_t findCueCloseParen(std::string_view line) {
+  size_t end = line.size();
+  size_t caret = endNonSpace(line, end);
+  if (caret > 0 && line[caret - 1] == '^')
+    end = endNonSpace(line, caret - 1);
+  if (end > 0 && line[end - 1] == ')')
+    return end - 1;
+  return std::string_view::npos;
+}
+
+// ^([^(\^]+?)\s*(?:\((.*)\))?(?:\s*\^\s*)?$
+bool matchCharacterCue(std::string_view line, std::string_view &name,
+                       std::optional<std::string_view> &extension) {
+  extension = std::nullopt;
+
+  size_t special = line.find_first_of("(^");
+  if (special == 0 || line.empty())
+    return false;
+  if (special == std::string_view::npos)
+    special = line.size();
+
+  name = line.substr(0, std::max<size_t>(endNonSpace(line, special), 1));
+
+  if (special == line.size())
+    return true;
+
+  if (line[special] == '^')
+    return firstNonSpace(line, special + 1) == line.size();
+
+  size_t close = findCueCloseParen(line);
+  if (close == std::string_view::npos || close <= special)
+    return false;
+  extension = line.substr(special + 1, close - special - 1);
+  return !hasLineTerminator(*extension);
+}
+
+// ^([A-Z][^a-z]*?)\s*(?:\(.*\))?(?:\s*\^\s*)?$
+bool matchCharacterCandidate(std::string_view line) {
+  if (line.empty() || !isUpper(line[0]))
+    return false;
+
+  size_t lower = 1;
+  while (lower < line.size() && !isLower(line[lower]))
+    lower++;
+  if (lower == line.size())
+    return true;
+
+  // Lower case is only allowed inside the trailing extension parentheses.
+  size_t open = line.rfind('(', lower);
+  if (open == std::string_view::npos || open == 0)
+    return false;
+  size_t close = findCueCloseParen(line);
+  return close != std::string_view::npos && close > open &&
+         !hasLineTerminator(line.substr(open + 1, close - open - 1));
+}
+
+// \s+#([^#\s]+), keeping only tags that are followed by whitespace or the end
+// of the line, and only once there's been something other than whitespace
+// before one. Returns the line up to the first tag kept, without trailing
+// whitespace.
+std::string_view extractTags(std::string_view line,
+                             std::vector<std::string_view> &tags) {
+  std::optional<size_t> firstMatch;
+  size_t pos = 0;
+
+  while (pos < line.size()) {
+    if (!isSpace(line[pos])) {
+      pos++;
+      continue;
+    }
+
+    size_t hash = pos;
+    while (hash < line.size() && isSpace(line[hash]))
+      hash++;
+    size_t end = hash + 1;
+    while (end < line.size() && line[end] != '#' && !isSpace(line[end]))
+      end++;
+
+    if (hash >= line.size() || line[hash] != '#' || end == hash + 1) {
+      // No match can start anywhere in this run of whitespace
+      pos = hash;
+      continue;
+    }
+
+    const size_t matchStart = pos;
+    pos = end;
+
+    if (end < line.size() && !isSpace(line[end]))
+      continue;
+
+    if (!firstMatch) {
+      if (line.substr(0, matchStart).find_first_not_of(" \t\r\n") ==
+          std::string_view::npos)
+        continue;
+      firstMatch = matchStart;
+    }
+
+    tags.push_back(line.substr(hash + 1, end - hash - 1));
+  }
+
+  std::string_view untagged = firstMatch ? line.substr(0, *firstMatch) : line;
+  return untagged.substr(0, untagged.find_last_not_of(" \t\r\n") + 1);
+}
+
+bool isDelimiter(char first, char second) {
+  return (first == '/' && second == '*') || (first == '*' && second == '/') ||
+         (first == '[' && second == '[') || (first == ']' && second == ']');
+}
+
+// Calls found with the start of every "/*", "*/", "[[" and "]]" in text, in
+// order, overlapping ones included. With SSE2 that's sixteen positions per
+// step, so a line without any costs a single sweep.
+template <typename Found>
+void forEachDelimiter(std::string_view text, Found &&found) {
+  const char *data = text.data();
+  size_t pos = 0;
+#if defined(__SSE2__)
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i star = _mm_set1_epi8('*');
+  const __m128i open = _mm_set1_epi8('[');
+  const __m128i close = _mm_set1_epi8(']');
+  for (; pos + 17 <= text.size(); pos += 16) {
+    const __m128i first =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+    const __m128i second =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos + 1));
+    auto pair = [&](__m128i a, __m128i b) {
+      return _mm_and_si128(_mm_cmpeq_epi8(first, a),
+                           _mm_cmpeq_epi8(second, b));
+    };
+    const __m128i hits =
+        _mm_or_si128(_mm_or_si128(pair(slash, star), pair(star, slash)),
+                     _mm_or_si128(pair(open, open), pair(close, close)));
+    for (unsigned mask = _mm_movemask_epi8(hits); mask; mask &= mask - 1)
+      found(pos + std::countr_zero(mask));
+  }
+#endif
+  for (; pos + 1 < text.size(); pos++) {
+    if (isDelimiter(data[pos], data[pos + 1]))
+      found(pos);
+  }
+}
+
+// As trimming replaceAll(line, "(CONT'D)", "") with both kinds of quote. Only
+// a line with "(CONT" in it needs a copy, which goes in buffer.
+std::string_view withoutContinued(std::string_view line, std::string &buffer) {
+  if (line.find("(CONT") == std::string_view::npos)
+    return trimView(line);
+
+  buffer.assign(line);
+  for (std::string_view contd : {"(CONT'D)", "(CONT’D)"}) {
+    size_t pos = 0;
+    while ((pos = buffer.find(contd, pos)) != std::string::npos)
+      buffer.erase(pos, contd.size());
+  }
+  return trimView(buffer);
+}
+
+// The first of the sorted positions at or after from.
+size_t firstFrom(const std::vector<size_t> &positions, size_t from) {
+  auto it = std::lower_bound(positions.begin(), positions.end(), from);
+  return (it != positions.end()) ? *it : std::string::npos;
+}
+
+// Whether element is an action that other actions can be merged into.
+bool isPlainAction(const Element *element) {
+  auto plain =
+      overloaded{[](const Action &action) { return !action.isCentered(); },
+                 [](const Element &) { return false; }};
+  return element && visit(*element, plain);
+}
+
+#ifdef SCREENPLAY_TOOLS_PARSE_STATS
+// Runs a rule, counting the attempt, the time it took and whether it matched.
+// A rule that returns nothing always matches.
+template <typename Parse>
+bool countRule(ParseStats &stats, ParseRule rule, Parse parse) {
+  using Clock = std::chrono::steady_clock;
+  ParseStats::Rule &counts = stats[rule];
+  counts.attempts++;
+
+  const auto start = Clock::now();
+  bool hit = true;
+  if constexpr (std::is_void_v<decltype(parse())>)
+    parse();
+  else
+    hit = parse();
+  counts.nanoseconds +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start)
+          .count();
+
+  if (hit)
+    counts.hits++;
+  return hit;
+}
+#endif
+
+} // namespace
+
+// Without SCREENPLAY_TOOLS_PARSE_STATS these are just the call, and nothing.
+#ifdef SCREENPLAY_TOOLS_PARSE_STATS
+#define PARSE_RULE(rule, call)                                                 \
+  countRule(stats, ParseRule::rule, [&] { return call; })
+#define PARSE_COUNT(counter) (stats.counter++)
+#else
+#define PARSE_RULE(rule, call) (call)
+#define PARSE_COUNT(counter) ((void)0)
+#endif
+
 Parser::Parser() : _script(std::make_shared<Script>()) {}
 
-void Parser::addText(const std::string &inputText) {
-  std::istringstream stream(inputText);
-  std::string line;
-  std::vector<std::string> lines;
+void Parser::addText(std::string_view inputText) {
+  // Lines are handed on as views into the caller's buffer. The newline search
+  // goes through memchr, which the C library vectorizes.
+  size_t start = 0;
+  while (start < inputText.size()) {
+    size_t end = inputText.find('\n', start);
+    if (end == std::string_view::npos)
+      end = inputText.size();
+
+    std::string_view line = inputText.substr(start, end - start);
+    if (line.ends_with('\r'))
+      line.remove_suffix(1);
+
+    addLine(line);
+    start = end + 1;
+  }
+
+  finalizeParsing();
+}
+
+void Parser::parseFile(const std::string &path) {
+  MappedFile file(path);
+  addText(file.getContents());
+}
+
+void Parser::addTextParallel(std::string_view inputText, unsigned threads) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  if (threads == 1 || !_supportsParallel()) {
+    addText(inputText);
+    return;
+  }
+
+  std::vector<std::string_view> lines;
+  size_t start = 0;
+  while (start < inputText.size()) {
+    size_t end = inputText.find('\n', start);
+    if (end == std::string_view::npos)
+      end = inputText.size();
+
+    std::string_view line = inputText.substr(start, end - start);
+    if (line.ends_with('\r'))
+      line.remove_suffix(1);
 
-  while (std::getline(stream, line)) {
     lines.push_back(line);
+    start = end + 1;
+  }
+
+  // Where each chunk starts, and how many notes and boneyards come before it.
+  struct Chunk {
+    size_t firstLine;
+    size_t noteCount;
+    size_t boneyardCount;
+  };
+  std::vector<Chunk> chunks{
+      {0, _script->getNotes().size(), _script->getBoneyards().size()}};
+
+  // Notes and boneyards are swapped out of each line before anything else, in
+  // a way that only depends on the lines themselves. Running just that step
+  // on a scratch parser shows where they are, so chunks can avoid starting
+  // inside one, and how many come before each chunk so its parser can number
+  // them as a sequential parse would. The scratch script is padded to match
+  // ours so its numbering lines up too.
+  Parser scanner;
+  for (size_t i = 0; i < chunks[0].noteCount; i++)
+    scanner._script->addNote(nullptr);
+  for (size_t i = 0; i < chunks[0].boneyardCount; i++)
+    scanner._script->addBoneyard(nullptr);
+  if (_currentBoneyard)
+    scanner._currentBoneyard = std::make_shared<Boneyard>("");
+  if (_currentNote)
+    scanner._currentNote = std::make_shared<Note>("");
+
+  const size_t minChunkLines =
+      std::max<size_t>(lines.size() / (threads * 4), 256);
+  bool afterEmptyLine = false;
+
+  for (size_t i = 0; i < lines.size(); i++) {
+    const std::string_view line = lines[i];
+    const bool outside = !scanner._currentBoneyard && !scanner._currentNote;
+
+    if (outside && afterEmptyLine &&
+        i - chunks.back().firstLine >= minChunkLines && _isChunkStart(line)) {
+      chunks.push_back({i, scanner._script->getNotes().size(),
+                        scanner._script->getBoneyards().size()});
+    }
+    afterEmptyLine = outside && line.empty();
+
+    scanner._line = line;
+    if (!scanner._parseBoneyard())
+      scanner._parseNotes();
   }
 
-  addLines(lines);
+  if (chunks.size() == 1) {
+    addText(inputText);
+    return;
+  }
+
+  // A chunk starts with a scene heading after an empty line, and a sequential
+  // parse is in the same state after such a heading whatever came before it.
+  // So later chunks can start from a fresh parser that's past the title page.
+  std::vector<Parser> parsers(chunks.size() - 1);
+  for (size_t k = 1; k < chunks.size(); k++) {
+    Parser &parser = parsers[k - 1];
+    parser.mergeActions = mergeActions;
+    parser.mergeDialogue = mergeDialogue;
+    parser.useTags = useTags;
+    parser._inTitlePage = false;
+    for (size_t i = 0; i < chunks[k].noteCount; i++)
+      parser._script->addNote(nullptr);
+    for (size_t i = 0; i < chunks[k].boneyardCount; i++)
+      parser._script->addBoneyard(nullptr);
+  }
+
+  std::atomic<size_t> nextChunk = 0;
+  auto work = [&]() {
+    for (size_t k = nextChunk++; k < chunks.size(); k = nextChunk++) {
+      Parser &parser = k == 0 ? *this : parsers[k - 1];
+      const size_t end =
+          k + 1 < chunks.size() ? chunks[k + 1].firstLine : lines.size();
+      for (size_t i = chunks[k].firstLine; i < end; i++)
+        parser.addLine(lines[i]);
+      if (k + 1 == chunks.size())
+        parser.finalizeParsing();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads && t < chunks.size(); t++)
+    pool.emplace_back(work);
+  work();
+  for (auto &thread : pool)
+    thread.join();
+
+#ifdef SCREENPLAY_TOOLS_PARSE_STATS
+  for (const Parser &parser : parsers)
+    stats += parser.stats;
+#endif
+
+  // Stitch the chunks together, skipping the padding. Each chunk interned its
+  // own tags and characters; taking them over in chunk order hands out the
+  // same ids as a sequential parse.
+  Script &script = *_script;
+  const size_t firstStitched = script._elements.size();
+  for (size_t k = 1; k < chunks.size(); k++) {
+    Script &chunkScript = *parsers[k - 1]._script;
+    for (const auto &name : chunkScript._tags.getStrings())
+      script.internTag(name);
+    for (Element *element : chunkScript._elements)
+      script._importTags(*element, chunkScript);
+    script._appendElements(chunkScript);
+    script._notes.insert(script._notes.end(),
+                         chunkScript._notes.begin() + chunks[k].noteCount,
+                         chunkScript._notes.end());
+    script._boneyards.insert(script._boneyards.end(),
+                             chunkScript._boneyards.begin() +
+                                 chunks[k].boneyardCount,
+                             chunkScript._boneyards.end());
+  }
+  script._reindexFrom(firstStitched > 0 ? firstStitched - 1 : 0);
+
+  // Carry on from where the last chunk left off
+  Parser &last = parsers.back();
+  const Script &lastScript = *last._script;
+  script._lastCue.reset();
+  if (lastScript._lastCue) {
+    const auto &cue = lastScript._cues[*lastScript._lastCue];
+    script._lastCue =
+        script._internCue(lastScript._characters[cue.character],
+                          lastScript._extensions[cue.extension]);
+  }
+  _inTitlePage = last._inTitlePage;
+  _multiLineTitleEntry = last._multiLineTitleEntry;
+  _lineBeforeBoneyard = last._lineBeforeBoneyard;
+  _currentBoneyard = last._currentBoneyard;
+  _lineBeforeNote = last._lineBeforeNote;
+  _currentNote = last._currentNote;
+  _padActions = std::move(last._padActions);
+  _pending = std::move(last._pending);
+  _lastLineWhitespaceOrEmpty = last._lastLineWhitespaceOrEmpty;
+  _lastLineEmpty = last._lastLineEmpty;
+  _lineTags = last._lineTags;
+  _inDialogue = last._inDialogue;
+
+  for (TagId &tag : _lineTags)
+    tag = script.internTag(lastScript.getTagName(tag));
+  for (auto &padAction : _padActions)
+    script._importTags(padAction, lastScript);
+  for (auto &pendingItem : _pending) {
+    script._importTags(pendingItem.element(), lastScript);
+    script._importTags(pendingItem.backup, lastScript);
+  }
+  _pruneTags();
 }
 
 void Parser::addLines(const std::vector<std::string> &lines) {
@@ -30,93 +596,261 @@ void Parser::addLines(const std::vector<std::string> &lines) {
   finalizeParsing();
 }
 
-void Parser::addLine(const std::string &inputLine) {
-  _lastLine = _line;
+void Parser::addLine(std::string_view inputLine) {
+  PARSE_COUNT(lines);
+  _line = inputLine;
+
+  _parseLine();
+
+  // _line may point into the caller's buffer, which needn't outlive this call,
+  // so only keep what the next line needs to know about it.
   _lastLineWhitespaceOrEmpty = isWhitespaceOrEmpty(_line);
+  _lastLineEmpty = _line.empty();
+  _line = {};
+  _lineTrim = {};
+}
 
-  _line = inputLine;
+void Parser::finalizeParsing() {
+  _line = {};
+  _lineTrim = {};
+  _parsePending();
+  _lastLineWhitespaceOrEmpty = true;
+  _lastLineEmpty = true;
+  _pruneTags();
+}
+
+void Parser::_pruneTags() {
+  Script &script = *_script;
+  // Without the tag index there's no cheap way to tell where tags are used
+  if (!script._keepIndexes || script._tags.size() == 0)
+    return;
+
+  // Elements and tags that are still to be added to the script
+  std::vector<Element *> waiting;
+  for (auto &padAction : _padActions)
+    waiting.push_back(&padAction);
+  for (auto &pendingItem : _pending) {
+    waiting.push_back(&pendingItem.element());
+    waiting.push_back(&pendingItem.backup);
+  }
 
-  if (_parseBoneyard() || _parseNotes())
+  // Where each tag is first used: which list of tags, counting the title
+  // entries, elements, waiting elements and line tags in that order, and where
+  // in the list. The index gives the first element for all but the last one.
+  constexpr size_t unused = SIZE_MAX;
+  std::vector<std::pair<size_t, size_t>> firstUse(script._tags.size(),
+                                                  {unused, 0});
+  auto use = [&](size_t list, const std::vector<TagId> &tags) {
+    for (size_t i = 0; i < tags.size(); i++) {
+      if (firstUse[tags[i]].first == unused)
+        firstUse[tags[i]] = {list, i};
+    }
+  };
+
+  const size_t titleCount = script._titleEntries.size();
+  const size_t elementCount = script._elements.size();
+  for (size_t i = 0; i < titleCount; i++)
+    use(i, script._titleEntries[i]->getTagIds());
+  for (size_t tag = 0; tag < script._tagIndex.size(); tag++) {
+    if (script._tagIndex[tag].empty() || firstUse[tag].first != unused)
+      continue;
+    const Element &first = *script._tagIndex[tag].front();
+    const size_t position = script._elements.positionOf(first);
+    const auto &tags = first.getTagIds();
+    firstUse[tag] = {titleCount + position,
+                     std::find(tags.begin(), tags.end(), tag) - tags.begin()};
+  }
+  if (elementCount > 0)
+    use(titleCount + elementCount - 1, script._elements.back()->getTagIds());
+  for (size_t i = 0; i < waiting.size(); i++)
+    use(titleCount + elementCount + i, waiting[i]->getTagIds());
+  use(titleCount + elementCount + waiting.size(), _lineTags);
+
+  // Nothing to do if they're already in that order, with none unused
+  if (std::is_sorted(firstUse.begin(), firstUse.end()) &&
+      firstUse.back().first != unused)
     return;
 
-  std::vector<std::string> newTags;
+  std::vector<std::string> lineTags;
+  for (TagId tag : _lineTags)
+    lineTags.push_back(script.getTagName(tag));
+  script._renumberTags(waiting);
+  _lineTags.clear();
+  for (const std::string &name : lineTags)
+    _lineTags.push_back(script.internTag(name));
+}
+
+void Parser::_parseLine() {
+  if (PARSE_RULE(Boneyard, _parseBoneyard()) ||
+      PARSE_RULE(Notes, _parseNotes()))
+    return;
+
+  // Kept in members so that their buffers get reused
+  _newTags.clear();
   if (useTags) {
-    auto [untagged, tags] = _extractTags(inputLine);
-    newTags = tags;
-    _line = untagged;
+    _tagNames.clear();
+    _line = extractTags(_line, _tagNames);
+    for (std::string_view tag : _tagNames)
+      _newTags.push_back(_script->internTag(tag));
   }
 
-  _lineTrim = trim(_line);
+  _lineTrim = trimView(_line);
 
   if (!_pending.empty())
     _parsePending();
 
-  _lineTags = newTags;
+  std::swap(_lineTags, _newTags);
 
-  if (_inTitlePage && _parseTitlePage())
+  if (_inTitlePage && PARSE_RULE(TitlePage, _parseTitlePage()))
     return;
 
-  if (_parseSection() || _parseForcedAction() || _parseForcedSceneHeading() ||
-      _parseForcedCharacter() || _parseForcedTransition() ||
-      _parsePageBreak() || _parseLyrics() || _parseSynopsis() ||
-      _parseCenteredAction() || _parseSceneHeading() || _parseTransition() ||
-      _parseParenthetical() || _parseCharacter() || _parseDialogue()) {
+  if (PARSE_RULE(Section, _parseSection()) ||
+      PARSE_RULE(ForcedAction, _parseForcedAction()) ||
+      PARSE_RULE(ForcedSceneHeading, _parseForcedSceneHeading()) ||
+      PARSE_RULE(ForcedCharacter, _parseForcedCharacter()) ||
+      PARSE_RULE(ForcedTransition, _parseForcedTransition()) ||
+      PARSE_RULE(PageBreak, _parsePageBreak()) ||
+      PARSE_RULE(Lyrics, _parseLyrics()) ||
+      PARSE_RULE(Synopsis, _parseSynopsis()) ||
+      PARSE_RULE(CenteredAction, _parseCenteredAction()) ||
+      PARSE_RULE(SceneHeading, _parseSceneHeading()) ||
+      PARSE_RULE(Transition, _parseTransition()) ||
+      PARSE_RULE(Parenthetical, _parseParenthetical()) ||
+      PARSE_RULE(Character, _parseCharacter()) ||
+      PARSE_RULE(Dialogue, _parseDialogue())) {
     return;
   }
 
-  _parseAction();
+  PARSE_RULE(Action, _parseAction());
 }
 
-void Parser::finalizeParsing() {
-  _line = "";
-  _lineTrim = "";
-  _parsePending();
+void Parser::_scanDelimiters() {
+  _delimiters.boneyardOpens.clear();
+  _delimiters.boneyardCloses.clear();
+  _delimiters.noteOpens.clear();
+  _delimiters.noteCloses.clear();
+
+  forEachDelimiter(_line, [this](size_t pos) {
+    switch (_line[pos]) {
+    case '/':
+      _delimiters.boneyardOpens.push_back(pos);
+      break;
+    case '*':
+      _delimiters.boneyardCloses.push_back(pos);
+      break;
+    case '[':
+      _delimiters.noteOpens.push_back(pos);
+      break;
+    default:
+      _delimiters.noteCloses.push_back(pos);
+      break;
+    }
+  });
 }
 
-std::shared_ptr<Element> Parser::_getLastElement() {
-  if (_script->getElements().empty())
-    return nullptr;
-  return _script->getElements().back();
+// Makes the line built up in _lineScratch the one being parsed. Swapping keeps
+// both buffers' capacity around for later lines.
+void Parser::_takeLineScratch() {
+  std::swap(_lineBuffer, _lineScratch);
+  _line = _lineBuffer;
 }
 
-void Parser::_addElement(std::shared_ptr<Element> element) {
+// Can a chunk start at this line, given that it follows an empty line outside
+// any boneyard or note? Only if it's sure to be parsed as a scene heading: no
+// notes or boneyards, and nothing an earlier rule would claim first. Turning
+// a line down is always safe, it just makes for longer chunks.
+bool Parser::_isChunkStart(std::string_view line) {
+  for (std::string_view delimiter : {"/*", "*/", "[[", "]]"}) {
+    if (line.find(delimiter) != std::string_view::npos)
+      return false;
+  }
 
-  element->appendTags(_lineTags);
-  _lineTags.clear();
+  auto isHeading = [](std::string_view text) {
+    std::string_view trimmed = trimView(text);
+    return !trimmed.empty() && (isUpper(trimmed[0]) || isLower(trimmed[0])) &&
+           trimmed.find("===") == std::string_view::npos &&
+           !hasLineTerminator(trimmed) && matchSceneHeading(trimmed);
+  };
+
+  if (!isHeading(line))
+    return false;
+  std::vector<std::string_view> tags;
+  return !useTags || isHeading(extractTags(line, tags));
+}
+
+void Parser::_discardParsed() {
+  Script &script = *_script;
+
+  if (script._keepIndexes) {
+    script._keepIndexes = false;
+    script._tagIndex.clear();
+    script._dialogueIndex.clear();
+    script._scenes.clear();
+    script._sceneNumbers.clear();
+    script._outline.clear();
+    script._inScene = false;
+  }
+
+  if (script._elements.size() > 1) {
+    ElementList none;
+    script._elements.replace(0, script._elements.size() - 1, none);
+  }
+
+  // Elements are freed as they're dropped rather than along with the script
+  script._dropArena();
+
+  _discardedNotes += script._notes.size();
+  script._notes.clear();
+  _discardedBoneyards += script._boneyards.size();
+  script._boneyards.clear();
+
+  if (!_inTitlePage)
+    script._titleEntries.clear();
+}
+
+Element *Parser::_getLastElement() { return _script->getLastElement(); }
+
+void Parser::_addElement(Element &&element) {
+
+  // The line's tags go on whichever element ends up in the script, so an
+  // element that's merged away never needs a copy of them
+  auto takeLineTags = [this](Element &target) {
+    target.appendTags(_lineTags);
+    _lineTags.clear();
+  };
 
   auto lastElement = _getLastElement();
 
   // Are we trying to add a blank action line?
-  if (element->getType() == ElementType::ACTION &&
-      isWhitespaceOrEmpty(element->getTextRaw()) &&
-      !std::dynamic_pointer_cast<Action>(element)->isCentered()) {
+  if (isPlainAction(&element) && isWhitespaceOrEmpty(element.getTextRaw())) {
 
     _inDialogue = false;
 
     // If this follows an existing action line, put it on as possible padding.
     if (lastElement && lastElement->getType() == ElementType::ACTION) {
-      _padActions.push_back(std::dynamic_pointer_cast<Action>(element));
+      takeLineTags(element);
+      _padActions.push_back(std::move(static_cast<Action &>(element)));
       return;
     }
+    _lineTags.clear();
     return;
   }
 
   // Add padding if there's some outstanding and we're just about to add another
   // action.
-  if (element->getType() == ElementType::ACTION && !_padActions.empty()) {
+  if (element.getType() == ElementType::ACTION && !_padActions.empty()) {
 
-    if (mergeActions && lastElement &&
-        lastElement->getType() == ElementType::ACTION &&
-        !std::dynamic_pointer_cast<Action>(lastElement)->isCentered()) {
+    if (mergeActions && isPlainAction(lastElement)) {
 
       for (const auto &padAction : _padActions) {
-        lastElement->appendLine(padAction->getTextRaw());
-        lastElement->appendTags(padAction->getTags());
+        lastElement->appendLine(padAction.getTextRaw());
+        lastElement->appendTags(padAction.getTagIds());
+        PARSE_COUNT(paddingMerges);
       }
 
     } else {
-      for (const auto &padAction : _padActions) {
-        _script->addElement(padAction);
+      for (auto &padAction : _padActions) {
+        _script->addElement(std::move(padAction));
       }
     }
   }
@@ -124,46 +858,46 @@ void Parser::_addElement(std::shared_ptr<Element> element) {
   _padActions.clear();
 
   // If we're allowing actions to be merged, do it here.
-  if (mergeActions && element->getType() == ElementType::ACTION &&
-      !std::dynamic_pointer_cast<Action>(element)->isCentered()) {
-
-    if (lastElement && lastElement->getType() == ElementType::ACTION &&
-        !std::dynamic_pointer_cast<Action>(lastElement)->isCentered()) {
-
-      lastElement->appendLine(element->getTextRaw());
-      lastElement->appendTags(element->getTags());
-      return;
-    }
+  if (mergeActions && isPlainAction(&element) && isPlainAction(lastElement)) {
+    lastElement->appendLine(element.getTextRaw());
+    lastElement->appendTags(element.getTagIds());
+    takeLineTags(*lastElement);
+    PARSE_COUNT(actionMerges);
+    return;
   }
 
-  _script->addElement(element);
-
-  _inDialogue = element->getType() == ElementType::CHARACTER ||
-                element->getType() == ElementType::PARENTHETICAL ||
-                element->getType() == ElementType::DIALOGUE;
+  takeLineTags(element);
+  _inDialogue = element.getType() == ElementType::CHARACTER ||
+                element.getType() == ElementType::PARENTHETICAL ||
+                element.getType() == ElementType::DIALOGUE;
+  _script->addElement(std::move(element));
 }
 
 void Parser::_parsePending() {
 
-  for (const auto &pendingItem : _pending) {
+  for (auto &pendingItem : _pending) {
 
-    pendingItem->element->appendTags(_lineTags);
-    pendingItem->backup->appendTags(_lineTags);
+    pendingItem.element().appendTags(_lineTags);
+    pendingItem.backup.appendTags(_lineTags);
     _lineTags.clear();
 
-    if (pendingItem->type == ElementType::TRANSITION) {
+    if (pendingItem.type == ElementType::TRANSITION) {
       if (isWhitespaceOrEmpty(
               _lineTrim)) { // Blank line, so it's definitely a transition
-        _addElement(pendingItem->element);
+        _addElement(std::move(pendingItem.element()));
+        PARSE_COUNT(transitions);
       } else {
-        _addElement(pendingItem->backup);
+        _addElement(std::move(pendingItem.backup));
+        PARSE_COUNT(transitionsAsAction);
       }
-    } else if (pendingItem->type == ElementType::CHARACTER) {
+    } else if (pendingItem.type == ElementType::CHARACTER) {
       if (!isWhitespaceOrEmpty(_lineTrim)) { // Filled line, so it's definitely
                                              // a piece of dialogue
-        _addElement(pendingItem->element);
+        _addElement(std::move(pendingItem.element()));
+        PARSE_COUNT(characters);
       } else {
-        _addElement(pendingItem->backup);
+        _addElement(std::move(pendingItem.backup));
+        PARSE_COUNT(charactersAsAction);
       }
     }
   }
@@ -171,25 +905,16 @@ void Parser::_parsePending() {
 }
 
 bool Parser::_parseTitlePage() {
-  static const std::regex regexTitleEntry(
-      R"(^\s*([A-Za-z0-9 ]+?)\s*:\s*(.*?)\s*$)");
-  static const std::regex regexTitleMultilineEntry(R"(^( {3,}|\t))");
-
-  std::smatch match;
-  if (std::regex_match(_line, match,
-                       regexTitleEntry)) { // It's of form key:text
-    std::string key = match[1].str();
-    std::string value = match[2].str();
-
+  std::string_view key, value;
+  if (matchTitleEntry(_line, key, value)) { // It's of form key:text
     _script->addTitleEntry(std::make_shared<TitleEntry>(key, value));
     _multiLineTitleEntry = value.empty();
     return true;
   }
 
   if (_multiLineTitleEntry) {
-    if (std::regex_search(
-            _line, match,
-            regexTitleMultilineEntry)) { // If we're expecting text on this line
+    // If we're expecting text on this line
+    if (matchTitleContinuation(_line)) {
       if (!_script->getTitleEntries().empty()) {
         _script->getTitleEntries().back()->appendLine(_line);
       }
@@ -212,7 +937,7 @@ bool Parser::_parseSection() {
     return false;
   }
 
-  _addElement(std::make_shared<Section>(trim(_lineTrim.substr(depth)), depth));
+  _addElement(Section(trimView(_lineTrim.substr(depth)), depth));
   return true;
 }
 
@@ -220,50 +945,43 @@ bool Parser::_parseLyrics() {
 
   if (_lineTrim.starts_with("~")) {
     // Create and add a FountainLyric element
-    _addElement(std::make_shared<Lyric>(trim(_lineTrim.substr(1))));
+    _addElement(Lyric(trimView(_lineTrim.substr(1))));
     return true;
   }
   return false;
 }
 
 bool Parser::_parseSynopsis() {
-  static const std::regex synopsisRegex(
-      R"(^=(?!\=))"); // Matches a single '=' not followed by another '='
+  // Matches a single '=' not followed by another '='
+  if (matchSynopsis(_lineTrim)) {
 
-  std::smatch match;
-  if (std::regex_search(_lineTrim, match, synopsisRegex)) {
-
-    _addElement(std::make_shared<Synopsis>(trim(_lineTrim.substr(1))));
+    _addElement(Synopsis(trimView(_lineTrim.substr(1))));
     return true;
   }
   return false;
 }
 
 std::optional<Parser::SceneHeadingInfo>
-Parser::_decodeSceneHeading(const std::string &line) {
+Parser::_decodeSceneHeading(std::string_view line) {
   // Matching heading followed by an optional sceneNumber (which is
   // numbers/letters/dash surrounded by #)
-  std::regex regex(R"((.*?)(?:\s*#([a-zA-Z0-9\-.]+?)#)?)");
-  std::smatch match;
+  std::string_view text;
+  std::optional<std::string_view> sceneNum;
 
-  if (std::regex_match(line, match, regex)) {
-    std::string text = match[1];
-    std::optional<std::string> sceneNum =
-        match[2].matched ? std::optional(match[2].str()) : std::nullopt;
-    return SceneHeadingInfo({text, sceneNum});
+  if (matchSceneNumber(line, text, sceneNum)) {
+    return SceneHeadingInfo(
+        {text, sceneNum ? std::optional(std::string(*sceneNum))
+                        : std::nullopt});
   }
   return std::nullopt;
 }
 
 bool Parser::_parseForcedSceneHeading() {
-  static const std::regex regexHeading(R"(^\.[a-zA-Z0-9])");
-
-  std::smatch match;
-  if (std::regex_search(_lineTrim, match, regexHeading)) {
+  if (matchForcedSceneHeading(_lineTrim)) {
     auto heading = _decodeSceneHeading(_lineTrim.substr(1));
     if (heading) {
-      _addElement(std::make_shared<SceneHeading>(heading->text,
-                                                 heading->sceneNumber, true));
+      _addElement(
+          SceneHeading(heading->text, std::move(heading->sceneNumber), true));
       return true;
     }
   }
@@ -271,18 +989,12 @@ bool Parser::_parseForcedSceneHeading() {
 }
 
 bool Parser::_parseSceneHeading() {
-  static const std::regex regexHeading(
-      R"(^\s*((INT|EXT|EST|INT\.\/EXT|INT\/EXT|I\/E)(\.|\s))|(FADE IN:\s*))",
-      std::regex::icase);
-
-  std::smatch match;
-  if (std::regex_search(_lineTrim, match, regexHeading)) {
+  if (matchSceneHeading(_lineTrim)) {
     auto headingOpt = _decodeSceneHeading(
         _lineTrim); // Decode the heading text and optional scene number
     if (headingOpt) {
-      const auto &[text, sceneNum] =
-          *headingOpt; // Extract text and scene number
-      _addElement(std::make_shared<SceneHeading>(text, sceneNum));
+      auto &[text, sceneNum] = *headingOpt; // Extract text and scene number
+      _addElement(SceneHeading(text, std::move(sceneNum)));
     }
     return true;
   }
@@ -293,7 +1005,7 @@ bool Parser::_parseSceneHeading() {
 bool Parser::_parseForcedTransition() {
 
   if (_lineTrim.starts_with(">") && !_lineTrim.ends_with("<")) {
-    _addElement(std::make_shared<Transition>(trim(_lineTrim.substr(1)), true));
+    _addElement(Transition(trimView(_lineTrim.substr(1)), true));
     return true;
   }
 
@@ -301,17 +1013,13 @@ bool Parser::_parseForcedTransition() {
 }
 
 bool Parser::_parseTransition() {
-  // Regex to match transition lines (e.g., "FADE TO:" or similar)
-  static const std::regex regexTransition(R"(^\s*(?:[A-Z\s]+TO:)\s*$)");
-
-  // Check if the line matches the regex and if the last line was empty
-  if (std::regex_match(_lineTrim, regexTransition) &&
-      _lastLineWhitespaceOrEmpty) {
+  // Check for transition lines (e.g., "FADE TO:" or similar) and if the last
+  // line was empty
+  if (matchTransition(_lineTrim) && _lastLineWhitespaceOrEmpty) {
 
     // Pending - only counts as an actual transition if the next line is empty
-    _pending.push_back(std::make_shared<PendingElement>(PendingElement{
-        ElementType::TRANSITION, std::make_shared<Transition>(_lineTrim),
-        _createAction(_lineTrim)}));
+    _pending.push_back({ElementType::TRANSITION, Transition(_lineTrim),
+                        std::nullopt, _createAction(_lineTrim)});
     return true;
   }
 
@@ -320,10 +1028,8 @@ bool Parser::_parseTransition() {
 
 bool Parser::_parseParenthetical() {
 
-  static const std::regex regexParenthetical(R"(^\s*\((.*)\)\s*$)");
-
-  std::smatch match;
-  if (std::regex_match(_line, match, regexParenthetical)) {
+  std::string_view inner;
+  if (matchParenthetical(_line, inner)) {
     auto lastElement = _getLastElement();
 
     // Check if the match was successful, we're in dialogue, and the last
@@ -332,7 +1038,7 @@ bool Parser::_parseParenthetical() {
         (lastElement->getType() == ElementType::CHARACTER ||
          lastElement->getType() == ElementType::DIALOGUE)) {
 
-      _addElement(std::make_shared<Parenthetical>(match[1].str()));
+      _addElement(Parenthetical(inner));
       return true;
     }
   }
@@ -341,24 +1047,21 @@ bool Parser::_parseParenthetical() {
 }
 
 std::optional<Parser::CharacterInfo>
-Parser::_decodeCharacter(const std::string &line) {
+Parser::_decodeCharacter(std::string_view line) {
   // Get rid of any variants of "(CONT'D)"
-  std::string noContLine = replaceAll(line, "(CONT'D)", "");
-  noContLine = replaceAll(noContLine, "(CONT’D)", "");
-  noContLine = trim(noContLine);
-
-  static const std::regex regexCharacter(
-      R"(^([^(\^]+?)\s*(?:\((.*)\))?(?:\s*\^\s*)?$)");
-  std::smatch match;
-
-  if (std::regex_match(noContLine, match, regexCharacter)) {
-    std::string name = match[1].str();
-    std::optional<std::string> extension =
-        match[2].matched ? std::optional(match[2].str()) : std::nullopt;
+  std::string_view noContLine = withoutContinued(line, _cueBuffer);
+
+  std::string_view name;
+  std::optional<std::string_view> extension;
+
+  if (matchCharacterCue(noContLine, name, extension)) {
     bool isDualDialogue = noContLine.back() == '^';
 
     // Return a populated CharacterInfo struct
-    return CharacterInfo{name, extension, isDualDialogue};
+    return CharacterInfo{std::string(name),
+                         extension ? std::optional(std::string(*extension))
+                                   : std::nullopt,
+                         isDualDialogue};
   }
   return std::nullopt; // No match found
 }
@@ -369,17 +1072,16 @@ bool Parser::_parseForcedCharacter() {
   if (_lineTrim.starts_with("@")) {
 
     // Remove the "@" prefix and trim the remaining string
-    std::string trimmedLine = _lineTrim.substr(1);
-    trimmedLine = trim(trimmedLine);
+    std::string_view trimmedLine = trimView(_lineTrim.substr(1));
 
     // Decode the character details
     auto characterOpt = _decodeCharacter(trimmedLine);
     if (characterOpt) {
-      auto character = *characterOpt;
+      auto &character = *characterOpt;
 
       // Create and add a FountainCharacter element
-      _addElement(std::make_shared<Character>(
-          character.name, character.extension, character.dual));
+      _addElement(Character(std::move(character.name),
+                            std::move(character.extension), character.dual));
       return true;
     }
   }
@@ -388,26 +1090,22 @@ bool Parser::_parseForcedCharacter() {
 }
 
 bool Parser::_parseCharacter() {
-  // Get rid of any variants of "(CONT'D)"
-  std::string noContLineTrim = replaceAll(_lineTrim, "(CONT'D)", "");
-  noContLineTrim = replaceAll(noContLineTrim, "(CONT’D)", "");
-  noContLineTrim = trim(noContLineTrim);
-
-  static const std::regex regexCharacter(
-      R"(^([A-Z][^a-z]*?)\s*(?:\(.*\))?(?:\s*\^\s*)?$)");
-  if (_lastLineWhitespaceOrEmpty &&
-      std::regex_match(noContLineTrim, regexCharacter)) {
+  // Get rid of any variants of "(CONT'D)". The line's been built by now, so
+  // _lineScratch is free to use.
+  std::string_view noContLineTrim = withoutContinued(_lineTrim, _lineScratch);
+
+  if (_lastLineWhitespaceOrEmpty && matchCharacterCandidate(noContLineTrim)) {
     auto characterOpt =
         _decodeCharacter(noContLineTrim); // Decode the character line
     if (characterOpt) {
-      auto character = *characterOpt;
+      auto &character = *characterOpt;
 
       // Can't 100% guarantee this is a character until next line
-      _pending.push_back(std::make_shared<PendingElement>(PendingElement{
-          ElementType::CHARACTER,
-          std::make_shared<Character>(character.name, character.extension,
-                                      character.dual),
-          _createAction(_lineTrim)}));
+      _pending.push_back({ElementType::CHARACTER, std::nullopt,
+                          Character(std::move(character.name),
+                                    std::move(character.extension),
+                                    character.dual),
+                          _createAction(_lineTrim)});
 
       return true;
     }
@@ -423,7 +1121,7 @@ bool Parser::_parseDialogue() {
   if (lastElement != nullptr && !_line.empty() &&
       (lastElement->getType() == ElementType::CHARACTER ||
        lastElement->getType() == ElementType::PARENTHETICAL)) {
-    _addElement(std::make_shared<Dialogue>(_lineTrim));
+    _addElement(Dialogue(_lineTrim));
     return true;
   }
 
@@ -433,13 +1131,14 @@ bool Parser::_parseDialogue() {
 
     // Special case - line-break in Dialogue. Only valid with more than one
     // white-space character in the line.
-    if (_lastLineWhitespaceOrEmpty && !_lastLine.empty()) {
+    if (_lastLineWhitespaceOrEmpty && !_lastLineEmpty) {
       if (mergeDialogue) {
         lastElement->appendLine("");
         lastElement->appendLine(_lineTrim);
+        PARSE_COUNT(dialogueMerges);
       } else {
-        _addElement(std::make_shared<Dialogue>(""));
-        _addElement(std::make_shared<Dialogue>(_lineTrim));
+        _addElement(Dialogue(""));
+        _addElement(Dialogue(_lineTrim));
       }
       return true;
     }
@@ -448,8 +1147,9 @@ bool Parser::_parseDialogue() {
     if (!_lastLineWhitespaceOrEmpty && !_lineTrim.empty()) {
       if (mergeDialogue) {
         lastElement->appendLine(_lineTrim);
+        PARSE_COUNT(dialogueMerges);
       } else {
-        _addElement(std::make_shared<Dialogue>(_lineTrim));
+        _addElement(Dialogue(_lineTrim));
       }
       return true;
     }
@@ -459,7 +1159,7 @@ bool Parser::_parseDialogue() {
 }
 
 bool Parser::_parseForcedAction() {
-  if (_lineTrim.rfind("!", 0) == 0) {
+  if (_lineTrim.starts_with("!")) {
     _addElement(_createAction(_lineTrim.substr(1), true));
     return true;
   }
@@ -471,12 +1171,12 @@ bool Parser::_parseCenteredAction() {
 
   if (_lineTrim.starts_with(">") && _lineTrim.ends_with("<")) {
     // Extract the content between ">" and "<"
-    std::string content = _lineTrim.substr(1, _lineTrim.length() - 2);
+    std::string_view content = _lineTrim.substr(1, _lineTrim.length() - 2);
 
-    auto centeredElement = _createAction(content);
-    centeredElement->setCentered(true);
+    Action centeredElement = _createAction(content);
+    centeredElement.setCentered(true);
 
-    _addElement(centeredElement);
+    _addElement(std::move(centeredElement));
     return true;
   }
 
@@ -487,188 +1187,185 @@ void Parser::_parseAction() { _addElement(_createAction(_line)); }
 
 bool Parser::_parsePageBreak() {
   if (_lineTrim.find("===") != std::string::npos) {
-    _addElement(std::make_shared<PageBreak>());
+    _addElement(PageBreak());
     return true;
   }
   return false;
 }
 
+std::string Parser::_lastBoneyardTag() const {
+  size_t id = _discardedBoneyards + _script->getBoneyards().size() - 1;
+  return "/*" + std::to_string(id) + "*/";
+}
+
+std::string Parser::_lastNoteTag() const {
+  size_t id = _discardedNotes + _script->getNotes().size() - 1;
+  return "[[" + std::to_string(id) + "]]";
+}
+
 bool Parser::_parseBoneyard() {
+  _scanDelimiters();
+  const auto &opens = _delimiters.boneyardOpens;
+  const auto &closes = _delimiters.boneyardCloses;
+  if (!_currentBoneyard && opens.empty())
+    return false;
 
-  size_t open = _line.find("/*");
-  size_t close = _line.find("*/", (open != std::string::npos) ? open : 0);
-  size_t lastTag = std::string::npos;
+  // The line with boneyards swapped for tags is built up once in _lineScratch,
+  // from the tags and the text before pos
+  std::string &out = _lineScratch;
+  out.clear();
+  size_t pos = 0;
+  bool replaced = false;
 
   // Handle in-line boneyards
+  size_t open = firstFrom(opens, 0);
+  size_t close = firstFrom(closes, (open != std::string::npos) ? open : 0);
   while (open != std::string::npos && close != std::string::npos &&
          close > open) {
     // Extract boneyard content
-    std::string boneyardText = _line.substr(open + 2, close - open - 2);
+    std::string_view boneyardText = _line.substr(open + 2, close - open - 2);
     _script->addBoneyard(std::make_shared<Boneyard>(boneyardText));
 
     // Replace boneyard content with a tag
-    std::string tag =
-        "/*" + std::to_string(_script->getBoneyards().size() - 1) + "*/";
-    _line = _line.substr(0, open) + tag + _line.substr(close + 2);
-
-    // Update position of lastTag
-    lastTag = open + tag.length();
+    out += _line.substr(pos, open - pos);
+    out += _lastBoneyardTag();
+    pos = close + 2;
+    replaced = true;
 
     // Search for the next pair of delimiters
-    open = _line.find("/*", lastTag);
-    close = _line.find("*/", lastTag);
+    open = firstFrom(opens, pos);
+    close = firstFrom(closes, pos);
   }
 
   // Check for entering boneyard content
   if (!_currentBoneyard) {
-    size_t idx = _line.find("/*", (lastTag != std::string::npos) ? lastTag : 0);
-    if (idx != std::string::npos) {
-      _lineBeforeBoneyard = _line.substr(0, idx);
-      _currentBoneyard = std::make_shared<Boneyard>(_line.substr(idx + 2));
+    if (open != std::string::npos) {
+      _lineBeforeBoneyard = out;
+      _lineBeforeBoneyard += _line.substr(pos, open - pos);
+      _currentBoneyard =
+          std::make_shared<Boneyard>(_line.substr(open + 2));
       return true;
     }
   } else {
     // Check for end of boneyard content
-    size_t idx = _line.find("*/", (lastTag != std::string::npos) ? lastTag : 0);
+    size_t idx = firstFrom(closes, pos);
     if (idx != std::string::npos) {
 
       // Append content and close the boneyard
-      _currentBoneyard->appendLine(_line.substr(0, idx));
+      out += _line.substr(pos, idx - pos);
+      _currentBoneyard->appendLine(out);
       _script->addBoneyard(_currentBoneyard);
 
       // Replace with a tag
-      std::string tag =
-          "/*" + std::to_string(_script->getBoneyards().size() - 1) + "*/";
-      _line = _lineBeforeBoneyard + tag + _line.substr(idx + 2);
+      out = _lineBeforeBoneyard;
+      out += _lastBoneyardTag();
+      pos = idx + 2;
+      replaced = true;
 
       // Reset state
       _lineBeforeBoneyard.clear();
       _currentBoneyard = nullptr;
     } else {
       // Still in boneyard
-      _currentBoneyard->appendLine(_line);
+      out += _line.substr(pos);
+      _currentBoneyard->appendLine(out);
       return true;
     }
   }
 
+  if (replaced) {
+    out += _line.substr(pos);
+    _takeLineScratch();
+    _scanDelimiters();
+  }
   return false;
 }
 
 bool Parser::_parseNotes() {
+  const auto &opens = _delimiters.noteOpens;
+  const auto &closes = _delimiters.noteCloses;
+  if (!_currentNote && opens.empty())
+    return false;
 
-  size_t open = _line.find("[[");
-  size_t close = _line.find("]]", (open != std::string::npos) ? open : 0);
-  size_t lastTag = std::string::npos;
+  // Built up as for boneyards
+  std::string &out = _lineScratch;
+  out.clear();
+  size_t pos = 0;
+  bool replaced = false;
 
+  size_t open = firstFrom(opens, 0);
+  size_t close = firstFrom(closes, (open != std::string::npos) ? open : 0);
   while (open != std::string::npos && close != std::string::npos &&
          close > open) {
     // Extract note text
-    std::string noteText = _line.substr(open + 2, close - open - 2);
+    std::string_view noteText = _line.substr(open + 2, close - open - 2);
 
     // Add the note to the script
     _script->addNote(std::make_shared<Note>(noteText));
 
     // Replace note with a tag
-    std::string tag =
-        "[[" + std::to_string(_script->getNotes().size() - 1) + "]]";
-    _line = _line.substr(0, open) + tag + _line.substr(close + 2);
-
-    // Update lastTag position
-    lastTag = open + tag.length();
+    out += _line.substr(pos, open - pos);
+    out += _lastNoteTag();
+    pos = close + 2;
+    replaced = true;
 
     // Find the next set of delimiters
-    open = _line.find("[[", lastTag);
-    close = _line.find("]]", lastTag);
+    open = firstFrom(opens, pos);
+    close = firstFrom(closes, pos);
   }
 
   if (!_currentNote) {
     // Start a new note
-    size_t idx = _line.find("[[", (lastTag != std::string::npos) ? lastTag : 0);
-    if (idx != std::string::npos) {
-      _lineBeforeNote = _line.substr(0, idx);
-      _currentNote = std::make_shared<Note>(_line.substr(idx + 2));
+    if (open != std::string::npos) {
+      _lineBeforeNote = out;
+      _lineBeforeNote += _line.substr(pos, open - pos);
+      _currentNote = std::make_shared<Note>(_line.substr(open + 2));
       _line = _lineBeforeNote;
       return true;
     }
   } else {
     // End or continue an existing note
-    size_t idx = _line.find("]]", (lastTag != std::string::npos) ? lastTag : 0);
+    size_t idx = firstFrom(closes, pos);
     if (idx != std::string::npos) {
       // End of note found
-      _currentNote->appendLine(_line.substr(0, idx));
+      out += _line.substr(pos, idx - pos);
+      _currentNote->appendLine(out);
       _script->addNote(_currentNote);
 
-      std::string tag =
-          "[[" + std::to_string(_script->getNotes().size() - 1) + "]]";
-      _line = _lineBeforeNote + tag + _line.substr(idx + 2);
+      out = _lineBeforeNote;
+      out += _lastNoteTag();
+      pos = idx + 2;
+      replaced = true;
       _lineBeforeNote = "";
       _currentNote = nullptr;
-    } else if (_line == "") {
+    } else if (_line.empty()) {
       // End of note due to line break
       _script->addNote(_currentNote);
 
-      std::string tag =
-          "[[" + std::to_string(_script->getNotes().size() - 1) + "]]";
-      _line = _lineBeforeNote + tag;
+      out = _lineBeforeNote;
+      out += _lastNoteTag();
+      replaced = true;
       _lineBeforeNote = "";
       _currentNote = nullptr;
     } else {
       // Still in note content
-      _currentNote->appendLine(_line);
+      out += _line.substr(pos);
+      _currentNote->appendLine(out);
       return true;
     }
   }
 
-  return false;
-}
-
-std::pair<std::string, std::vector<std::string>>
-Parser::_extractTags(const std::string &line) {
-  std::regex regex(R"(\s+#([^#\s]+))"); // Ensures tags start with '#' and do
-                                        // not contain another '#'
-  std::vector<std::string> tags;
-  std::sregex_iterator it(line.begin(), line.end(), regex);
-  std::sregex_iterator end;
-
-  std::optional<size_t> firstMatchIndex;
-
-  for (; it != end; ++it) {
-    size_t matchIndex = it->position();
-    std::string tag = (*it)[1].str();
-    size_t tagEnd = matchIndex + it->length(); // Position after the matched tag
-
-    // Ensure the character after the tag is either whitespace or EOL
-    if (tagEnd < line.size() && !std::isspace(line[tagEnd]))
-      continue;
-
-    // Ensure there is at least one non-whitespace character before the first
-    // match
-    if (!firstMatchIndex) {
-      if (line.substr(0, matchIndex).find_first_not_of(" \t\r\n") ==
-          std::string::npos) {
-        continue;
-      }
-    }
-
-    tags.push_back(tag);
-
-    if (!firstMatchIndex)
-      firstMatchIndex = matchIndex;
+  if (replaced) {
+    out += _line.substr(pos);
+    _takeLineScratch();
   }
-
-  // Extract the untagged part (before the first tag)
-  std::string untagged =
-      firstMatchIndex ? line.substr(0, *firstMatchIndex) : line;
-
-  // Trim trailing whitespace from untagged
-  untagged.erase(untagged.find_last_not_of(" \t\r\n") + 1);
-
-  return {untagged, tags};
+  return false;
 }
 
-std::shared_ptr<Action> Parser::_createAction(const std::string &text,
-                                              bool forced) {
-  return std::make_shared<Action>(replaceAll(text, "\t", "    "), forced);
+Action Parser::_createAction(std::string_view text, bool forced) {
+  if (text.find('\t') == std::string_view::npos)
+    return Action(text, forced);
+  return Action(replaceAll(std::string(text), "\t", "    "), forced);
 }
 
 } // namespace Fountain
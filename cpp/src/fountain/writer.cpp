@@ -3,85 +3,114 @@
 
 #include "screenplay_tools/fountain/writer.h"
 #include "screenplay_tools/utils.h"
-#include <regex>
-#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 namespace ScreenplayTools {
 namespace Fountain {
 
-Writer::Writer() : _lastChar("") {}
+namespace {
 
-std::string replaceNotes(const std::string &text, const Script &script) {
-  std::regex regexNotes(R"(\[\[(\d+)\]\])");
-  std::sregex_iterator begin(text.begin(), text.end(), regexNotes);
-  std::sregex_iterator end;
+// Output goes to a sink in blocks of about this size
+constexpr size_t blockSize = 64 * 1024;
 
-  std::ostringstream result;
-  size_t lastPos = 0;
-
-  for (auto it = begin; it != end; ++it) {
-    const std::smatch &match = *it;
-
-    // Append text before the match
-    result << text.substr(lastPos, match.position() - lastPos);
-
-    // Custom replacement
-    int num = std::stoi(match[1].str());
-    result << "[[" << script.getNotes()[num]->getTextRaw() << "]]";
-
-    // Update the last position
-    lastPos = match.position() + match.length();
-  }
-
-  // Append remaining text after the last match
-  result << text.substr(lastPos);
-
-  return result.str();
+// How many characters at the start of text trimOuterNewlines() would take off
+size_t leadingLineEnds(std::string_view text) {
+  const size_t begin = text.starts_with('\r') ? 1 : 0;
+  size_t end = begin;
+  while (end < text.size() && text[end] == '\n')
+    end++;
+  return end > begin ? end : 0;
 }
 
-std::string replaceBoneyards(const std::string &text, const Script &script) {
-  std::regex regexBoneyards(R"(/\*(\d+)\*/)");
-  std::sregex_iterator begin(text.begin(), text.end(), regexBoneyards);
-  std::sregex_iterator end;
+// And how many at the end
+size_t trailingLineEnds(std::string_view text) {
+  size_t begin = text.size();
+  while (begin > 0 && text[begin - 1] == '\n')
+    begin--;
+  if (begin == text.size())
+    return 0;
+  if (begin > 0 && text[begin - 1] == '\r')
+    begin--;
+  return text.size() - begin;
+}
 
-  std::ostringstream result;
-  size_t lastPos = 0;
+bool isLineEnd(char c) { return c == '\n' || c == '\r'; }
+
+// Roughly how long the output for script will be, from the lengths of the
+// texts in it, so that write() seldom has to grow its string. Going through
+// the script to get the exact length would cost as much as writing it.
+size_t estimateSize(const Script &script) {
+  size_t size = 0;
+  for (const auto &entry : script.getTitleEntries())
+    size += entry->getKey().size() + entry->getTextRaw().size() + 3;
+  for (const auto &element : script.getElements())
+    size += element->getTextRaw().size() + 8;
+  for (const auto &note : script.getNotes())
+    size += note->getTextRaw().size();
+  for (const auto &boneyard : script.getBoneyards())
+    size += boneyard->getTextRaw().size();
+  return size + size / 8;
+}
 
-  for (auto it = begin; it != end; ++it) {
-    const std::smatch &match = *it;
+} // namespace
 
-    // Append text before the match
-    result << text.substr(lastPos, match.position() - lastPos);
+Writer::Writer() {}
 
-    // Custom replacement
-    int num = std::stoi(match[1].str());
-    result << "/*" << script.getBoneyards()[num]->getTextRaw() << "*/";
+std::string Writer::write(const Script &script) {
+  _output.clear();
+  _output.reserve(estimateSize(script));
+  _sink = nullptr;
+  _writeScript(script, Target::Buffer);
+  return std::move(_output);
+}
 
-    // Update the last position
-    lastPos = match.position() + match.length();
-  }
+void Writer::write(const Script &script, OutputSink &sink) {
+  _output.clear();
+  _output.reserve(blockSize * 2);
+  _sink = &sink;
+  _writeScript(script, Target::Buffer);
+  if (!_output.empty())
+    sink.write(_output);
+  _output.clear();
+  _sink = nullptr;
+}
 
-  // Append remaining text after the last match
-  result << text.substr(lastPos);
+size_t Writer::write(const Script &script, std::span<char> output) {
+  _span = output;
+  _writeScript(script, Target::Span);
+  _span = {};
+  return _size;
+}
 
-  return result.str();
+size_t Writer::measure(const Script &script) {
+  _writeScript(script, Target::Count);
+  return _size;
 }
 
-std::string Writer::write(const Script &script) {
-  std::vector<std::string> lines;
+void Writer::_writeScript(const Script &script, Target target) {
+  _script = &script;
+  _target = target;
+  _size = 0;
+  _lastCue.reset();
+  _heldLineEnds.clear();
+  _firstLine = true;
+  _started = false;
 
   // Write title entries
   if (!script.getTitleEntries().empty()) {
     for (const auto &entry : script.getTitleEntries()) {
-      lines.push_back(_writeElement(entry));
+      _beginLine();
+      _writeElement(*entry);
     }
-    lines.push_back(""); // Add a blank line after titles
+    _beginLine(); // Add a blank line after titles
   }
 
   // Write elements
-  std::shared_ptr<Element> lastElem = nullptr;
+  const Element *lastElem = nullptr;
 
-  for (const auto &element : script.getElements()) {
+  for (const Element *element : script.getElements()) {
     // Determine padding
     bool padBefore = false;
     if (element->getType() == ElementType::CHARACTER ||
@@ -93,150 +122,257 @@ std::string Writer::write(const Script &script) {
     }
 
     if (padBefore) {
-      lines.push_back("");
+      _beginLine();
     }
 
-    lines.push_back(_writeElement(element));
+    _beginLine();
+    _writeElement(*element);
     lastElem = element;
   }
 
-  // Join lines into a single text
-  std::string text = join(lines, "\n");
-
-  // Replace notes
-  text = replaceNotes(text, script);
-
-  // Replace boneyards
-  text = replaceBoneyards(text, script);
-
-  return trimOuterNewlines(text);
-}
-
-std::string Writer::_writeElement(const std::shared_ptr<Element> &elem) {
-  switch (elem->getType()) {
-  case ElementType::CHARACTER:
-    return _writeCharacter(std::dynamic_pointer_cast<Character>(elem));
-  case ElementType::DIALOGUE:
-    return _writeDialogue(std::dynamic_pointer_cast<Dialogue>(elem));
-  case ElementType::PARENTHETICAL:
-    return _writeParenthetical(std::dynamic_pointer_cast<Parenthetical>(elem));
-  case ElementType::ACTION:
-    return _writeAction(std::dynamic_pointer_cast<Action>(elem));
-  case ElementType::LYRIC:
-    return "~ " + elem->getTextRaw();
-  case ElementType::SYNOPSIS:
-    return "= " + elem->getTextRaw();
-  case ElementType::TITLEENTRY:
-    return std::dynamic_pointer_cast<TitleEntry>(elem)->getKey() + ": " +
-           elem->getTextRaw();
-  case ElementType::HEADING:
-    return _writeHeading(std::dynamic_pointer_cast<SceneHeading>(elem));
-  case ElementType::TRANSITION:
-    return _writeTransition(std::dynamic_pointer_cast<Transition>(elem));
-  case ElementType::PAGEBREAK:
-    return "===";
-  case ElementType::SECTION:
-    return "\n" +
-           std::string(std::dynamic_pointer_cast<Section>(elem)->getLevel(),
-                       '#') +
-           " " + elem->getTextRaw();
-  default:
-    _lastChar.clear();
-    return "";
-  }
+  _script = nullptr;
+
+  // Trim the line ends off the ends, as trimOuterNewlines() would
+  std::string_view held = _heldLineEnds;
+  if (!_started)
+    held.remove_prefix(leadingLineEnds(held));
+  held.remove_suffix(trailingLineEnds(held));
+  _emit(held);
+  _heldLineEnds.clear();
 }
 
-std::string Writer::_writeCharacter(const std::shared_ptr<Character> &elem) {
-  std::string pad = prettyPrint ? std::string(3, '\t') : "";
-  std::string charText = elem->getName();
+// Lines are joined with a line end, so every line but the first starts with
+// one.
+void Writer::_beginLine() {
+  if (!_firstLine)
+    _put('\n');
+  _firstLine = false;
+}
 
-  if (elem->isDualDialogue()) {
-    charText += " ^";
-  }
-  if (elem->getExtension().has_value()) {
-    charText += " (" + elem->getExtension().value() + ")";
-  }
-  if (elem->isForced()) {
-    charText = "@" + charText;
+void Writer::_put(std::string_view text) {
+  if (text.empty())
+    return;
+  if (!isLineEnd(text.front()) && !isLineEnd(text.back())) {
+    _releaseLineEnds();
+    _emit(text);
+    return;
   }
-  std::string extChar =
-      elem->getName() +
-      (elem->getExtension().has_value() ? elem->getExtension().value() : "");
-  if (_lastChar == extChar) {
-    charText += " (CONT'D)";
+
+  const size_t first = text.find_first_not_of("\r\n");
+  if (first == std::string_view::npos) {
+    _heldLineEnds += text;
+    return;
   }
+  const size_t last = text.find_last_not_of("\r\n");
 
-  _lastChar = extChar;
-  return pad + charText;
+  _heldLineEnds += text.substr(0, first);
+  _releaseLineEnds();
+  _emit(text.substr(first, last + 1 - first));
+  _heldLineEnds = text.substr(last + 1);
 }
 
-std::string Writer::_writeDialogue(const std::shared_ptr<Dialogue> &elem) {
-  std::istringstream iss(elem->getTextRaw());
-  std::ostringstream oss;
-  std::string line;
-
-  // Ensure blank lines in dialogue have at least a space
-  while (std::getline(iss, line)) {
-    if (!oss.str().empty())
-      oss << "\n";
-    oss << (line.empty() ? " " : line);
+void Writer::_put(char c) {
+  if (isLineEnd(c)) {
+    _heldLineEnds += c;
+    return;
   }
+  _releaseLineEnds();
+  _emit(std::string_view(&c, 1));
+}
+
+// Something other than a line end is being written, so the line ends before
+// it are only trimmed if they started the output.
+void Writer::_releaseLineEnds() {
+  if (_started && _heldLineEnds.empty())
+    return;
+
+  std::string_view held = _heldLineEnds;
+  if (!_started)
+    held.remove_prefix(leadingLineEnds(held));
+  _started = true;
+  _emit(held);
+  _heldLineEnds.clear();
+}
 
-  std::string output = oss.str();
+void Writer::_emit(std::string_view text) {
+  switch (_target) {
+  case Target::Count:
+    break;
+  case Target::Span:
+    if (text.size() > _span.size() - _size)
+      throw std::length_error("Fountain output is longer than its buffer");
+    std::memcpy(_span.data() + _size, text.data(), text.size());
+    break;
+  case Target::Buffer:
+    _output += text;
+    if (_sink && _output.size() >= blockSize) {
+      _sink->write(_output);
+      _output.clear();
+    }
+    break;
+  }
+  _size += text.size();
+}
 
-  // Add tab for pretty printing
-  if (prettyPrint) {
-    output = _addTabs(output, 1);
+void Writer::_writeText(std::string_view text,
+                        const std::vector<Annotation> &annotations,
+                        size_t begin, size_t end, bool notes) {
+  auto it = std::lower_bound(
+      annotations.begin(), annotations.end(), begin,
+      [](const Annotation &a, size_t offset) { return a.offset < offset; });
+
+  size_t pos = begin;
+  for (; it != annotations.end() && it->offset + it->length <= end; ++it) {
+    _put(text.substr(pos, it->offset - pos));
+    pos = it->offset + it->length;
+
+    // A boneyard's text is kept as written, but a note can have boneyards in
+    // it. Anything that doesn't refer to this script stays as it is.
+    if (it->type == ElementType::NOTE && notes &&
+        it->id < _script->getNotes().size()) {
+      const Note &note = *_script->getNotes()[it->id];
+      _put("[[");
+      _writeText(note.getTextRaw(), note.getAnnotations(), 0,
+                 note.getTextRaw().size(), false);
+      _put("]]");
+    } else if (it->type == ElementType::BONEYARD &&
+               it->id < _script->getBoneyards().size()) {
+      _put("/*");
+      _put(_script->getBoneyards()[it->id]->getTextRaw());
+      _put("*/");
+    } else {
+      _put(text.substr(it->offset, it->length));
+    }
   }
+  _put(text.substr(pos, end - pos));
+}
 
-  return output;
+void Writer::_writeText(const Element &elem) {
+  _writeText(elem.getTextRaw(), elem.getAnnotations(), 0,
+             elem.getTextRaw().size());
 }
 
-std::string
-Writer::_writeParenthetical(const std::shared_ptr<Parenthetical> &elem) {
-  std::string pad = prettyPrint ? std::string(2, '\t') : "";
-  return pad + "(" + elem->getTextRaw() + ")";
+void Writer::_writeText(const std::string &text) {
+  _writeText(text, findAnnotations(text), 0, text.size());
 }
 
-std::string Writer::_writeAction(const std::shared_ptr<Action> &elem) {
-  if (elem->isForced()) {
-    return "!" + elem->getTextRaw();
+void Writer::_writeElement(const Element &elem) {
+  visit(elem,
+        overloaded{
+            [this](const Character &e) { _writeCharacter(e); },
+            [this](const Dialogue &e) { _writeDialogue(e); },
+            [this](const Parenthetical &e) { _writeParenthetical(e); },
+            [this](const Action &e) { _writeAction(e); },
+            [this](const Lyric &e) {
+              _put("~ ");
+              _writeText(e);
+            },
+            [this](const Synopsis &e) {
+              _put("= ");
+              _writeText(e);
+            },
+            [this](const TitleEntry &e) {
+              _writeText(e.getKey());
+              _put(": ");
+              _writeText(e);
+            },
+            [this](const SceneHeading &e) { _writeHeading(e); },
+            [this](const Transition &e) { _writeTransition(e); },
+            [this](const PageBreak &) { _put("==="); },
+            [this](const Section &e) {
+              _put('\n');
+              for (int i = 0; i < e.getLevel(); i++)
+                _put('#');
+              _put(' ');
+              _writeText(e);
+            },
+            [this](const Element &) { _lastCue.reset(); }});
+}
+
+void Writer::_writeCharacter(const Character &elem) {
+  if (prettyPrint)
+    _put("\t\t\t");
+  if (elem.isForced())
+    _put('@');
+  _writeText(elem.getName());
+
+  if (elem.isDualDialogue()) {
+    _put(" ^");
+  }
+  if (elem.getExtension().has_value()) {
+    _put(" (");
+    _writeText(elem.getExtension().value());
+    _put(')');
+  }
+  if (_lastCue == elem.getCueId()) {
+    _put(" (CONT'D)");
   }
-  if (elem->isCentered()) {
-    return ">" + elem->getTextRaw() + "<";
+
+  _lastCue = elem.getCueId();
+}
+
+void Writer::_writeDialogue(const Dialogue &elem) {
+  const std::string &text = elem.getTextRaw();
+
+  // Ensure blank lines in dialogue have at least a space, and add a tab for
+  // pretty printing. Only the dialogue's own lines count here, not any in its
+  // notes.
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = std::min(text.find('\n', start), text.size());
+    if (start > 0)
+      _put('\n');
+    if (prettyPrint)
+      _put('\t');
+    if (end == start)
+      _put(' ');
+    else
+      _writeText(text, elem.getAnnotations(), start, end);
+    start = end + 1;
   }
-  return elem->getTextRaw();
 }
 
-std::string Writer::_writeHeading(const std::shared_ptr<SceneHeading> &elem) {
-  std::string sceneNum = elem->getSceneNumber().has_value()
-                             ? " #" + elem->getSceneNumber().value() + "#"
-                             : "";
-  if (elem->isForced()) {
-    return "\n." + elem->getTextRaw() + sceneNum;
+void Writer::_writeParenthetical(const Parenthetical &elem) {
+  if (prettyPrint)
+    _put("\t\t");
+  _put('(');
+  _writeText(elem);
+  _put(')');
+}
+
+void Writer::_writeAction(const Action &elem) {
+  if (elem.isForced()) {
+    _put('!');
+    _writeText(elem);
+  } else if (elem.isCentered()) {
+    _put('>');
+    _writeText(elem);
+    _put('<');
+  } else {
+    _writeText(elem);
   }
-  return "\n" + elem->getTextRaw() + sceneNum;
 }
 
-std::string Writer::_writeTransition(const std::shared_ptr<Transition> &elem) {
-  std::string pad = prettyPrint ? std::string(4, '\t') : "";
-  if (elem->isForced()) {
-    return ">" + elem->getTextRaw();
+void Writer::_writeHeading(const SceneHeading &elem) {
+  _put('\n');
+  if (elem.isForced())
+    _put('.');
+  _writeText(elem);
+  if (elem.getSceneNumber().has_value()) {
+    _put(" #");
+    _writeText(*elem.getSceneNumber());
+    _put('#');
   }
-  return pad + elem->getTextRaw();
 }
 
-std::string Writer::_addTabs(const std::string &input, int count) {
-  std::istringstream iss(input);
-  std::ostringstream oss;
-  std::string line;
-  while (std::getline(iss, line)) {
-    if (!oss.str().empty())
-      oss << "\n";
-    oss << std::string(count, '\t') << line;
+void Writer::_writeTransition(const Transition &elem) {
+  if (elem.isForced()) {
+    _put('>');
+  } else if (prettyPrint) {
+    _put("\t\t\t\t");
   }
-  return oss.str();
+  _writeText(elem);
 }
 
 } // namespace Fountain
-} // namespace ScreenplayTools
\ No newline at end of file
+} // namespace ScreenplayTools
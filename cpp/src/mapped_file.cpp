@@ -0,0 +1,103 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "mapped_file.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ScreenplayTools {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path) {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("Failed to open file: " + path);
+  _file = file;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    throw std::runtime_error("Failed to read file size: " + path);
+  }
+  _size = static_cast<size_t>(size.QuadPart);
+
+  // Empty files can't be mapped; leave the contents empty.
+  if (_size == 0)
+    return;
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    throw std::runtime_error("Failed to map file: " + path);
+  }
+  _mapping = mapping;
+
+  _data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!_data) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    throw std::runtime_error("Failed to map file: " + path);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (_data)
+    UnmapViewOfFile(_data);
+  if (_mapping)
+    CloseHandle(_mapping);
+  if (_file)
+    CloseHandle(_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Failed to open file: " + path);
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw std::runtime_error("Failed to read file size: " + path);
+  }
+  _size = static_cast<size_t>(info.st_size);
+
+  // Empty files can't be mapped; leave the contents empty.
+  if (_size == 0) {
+    close(fd);
+    return;
+  }
+
+  void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  if (data == MAP_FAILED)
+    throw std::runtime_error("Failed to map file: " + path);
+
+  // Both parsers read front to back.
+  madvise(data, _size, MADV_SEQUENTIAL);
+  _data = data;
+}
+
+MappedFile::~MappedFile() {
+  if (_data)
+    munmap(const_cast<void *>(_data), _size);
+}
+
+#endif
+
+} // namespace ScreenplayTools
@@ -0,0 +1,35 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace ScreenplayTools {
+
+// Read-only memory mapping of a whole file. The contents stay valid for the
+// lifetime of the object. Throws std::runtime_error if the file can't be
+// opened or mapped.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  std::string_view getContents() const {
+    return std::string_view(static_cast<const char *>(_data), _size);
+  }
+
+private:
+  const void *_data = nullptr;
+  size_t _size = 0;
+#ifdef _WIN32
+  void *_file = nullptr;
+  void *_mapping = nullptr;
+#endif
+};
+
+} // namespace ScreenplayTools
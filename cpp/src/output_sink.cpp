@@ -0,0 +1,37 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "screenplay_tools/output_sink.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ScreenplayTools {
+
+void FileDescriptorSink::write(std::string_view text) {
+  while (!text.empty()) {
+#ifdef _WIN32
+    const unsigned size =
+        static_cast<unsigned>(std::min<size_t>(text.size(), INT_MAX));
+    const int written = ::_write(_fd, text.data(), size);
+#else
+    const ssize_t written = ::write(_fd, text.data(), text.size());
+#endif
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      throw std::runtime_error("Failed to write to file descriptor " +
+                               std::to_string(_fd));
+    }
+    text.remove_prefix(static_cast<size_t>(written));
+  }
+}
+
+} // namespace ScreenplayTools
@@ -3,7 +3,8 @@
 
 #include "screenplay_tools/screenplay.h"
 #include "screenplay_tools/utils.h"
-#include <regex>
+#include <algorithm>
+#include <cstdint>
 #include <unordered_map>
 
 namespace ScreenplayTools {
@@ -34,9 +35,71 @@ std::string Element::dump() const {
   return elementTypeToString(_type) + ":\"" + _textRaw + "\"";
 }
 
-void Element::_updateText() {
-  const std::regex regex(R"(\[\[\d+\]\]|\/*\d+\*\/)");
-  _textClean = std::regex_replace(_textRaw, regex, "");
+namespace {
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Finds the first "[[id]]" or "/*id*/" at or after `from`. Returns false if
+// there isn't one.
+bool findAnnotation(std::string_view text, size_t from,
+                    Annotation &annotation) {
+  for (size_t i = text.find_first_of("[/", from); i != std::string_view::npos;
+       i = text.find_first_of("[/", i + 1)) {
+    bool note = text[i] == '[';
+    if (text.substr(i, 2) != (note ? "[[" : "/*"))
+      continue;
+
+    size_t j = i + 2;
+    size_t id = 0;
+    while (j < text.size() && isDigit(text[j]))
+      id = id * 10 + (text[j++] - '0');
+    if (j == i + 2 || text.substr(j, 2) != (note ? "]]" : "*/"))
+      continue;
+
+    annotation = {note ? ElementType::NOTE : ElementType::BONEYARD, i,
+                  j + 2 - i, id};
+    return true;
+  }
+  return false;
+}
+
+} // namespace
+
+std::vector<Annotation> findAnnotations(std::string_view text) {
+  std::vector<Annotation> annotations;
+  Annotation annotation;
+  size_t pos = 0;
+  while (findAnnotation(text, pos, annotation)) {
+    annotations.push_back(annotation);
+    pos = annotation.offset + annotation.length;
+  }
+  return annotations;
+}
+
+void Element::_appendText(std::string_view text) {
+  Annotation annotation;
+  if (!_hasReferences) {
+    // References always end in "]]" or "*/", so most text can skip the search
+    if (text.find_first_of("]*") == std::string_view::npos ||
+        !findAnnotation(text, 0, annotation)) {
+      _textRaw += text;
+      return;
+    }
+    _textClean = _textRaw;
+    _hasReferences = true;
+  }
+
+  const size_t base = _textRaw.size();
+  _textRaw += text;
+
+  size_t pos = 0;
+  while (findAnnotation(text, pos, annotation)) {
+    _textClean += text.substr(pos, annotation.offset - pos);
+    pos = annotation.offset + annotation.length;
+    annotation.offset += base;
+    _annotations.push_back(annotation);
+  }
+  _textClean += text.substr(pos);
 }
 
 // TitleEntry
@@ -79,23 +142,325 @@ std::string Section::dump() const {
          std::to_string(_level) + ")";
 }
 
+// ElementArena
+ElementArena::~ElementArena() {
+  for (auto it = _elements.rbegin(); it != _elements.rend(); ++it)
+    (*it)->~Element();
+}
+
+void *ElementArena::allocate(size_t size, size_t alignment) {
+  size_t padding =
+      (alignment - reinterpret_cast<uintptr_t>(_next) % alignment) % alignment;
+
+  if (!_next || padding + size > _remaining) {
+    // Grow geometrically up to 1MB blocks; oversized requests get their own.
+    constexpr size_t maxBlockSize = 1024 * 1024;
+    size_t blockSize = std::max(_blockSize, size + alignment);
+    _blocks.emplace_back(new std::byte[blockSize]);
+    _next = _blocks.back().get();
+    _remaining = blockSize;
+    _blockSize = std::min(_blockSize * 2, maxBlockSize);
+
+    padding = (alignment - reinterpret_cast<uintptr_t>(_next) % alignment) %
+              alignment;
+  }
+
+  void *result = _next + padding;
+  _next += padding + size;
+  _remaining -= padding + size;
+  return result;
+}
+
+void ElementArena::adopt(ElementArena &other) {
+  _blocks.insert(_blocks.end(), std::make_move_iterator(other._blocks.begin()),
+                 std::make_move_iterator(other._blocks.end()));
+  _elements.insert(_elements.end(), other._elements.begin(),
+                   other._elements.end());
+  other._blocks.clear();
+  other._elements.clear();
+  other._next = nullptr;
+  other._remaining = 0;
+}
+
+// ElementList
+ElementList::ElementList(ElementList &&other) noexcept
+    : _blocks(std::move(other._blocks)), _size(std::exchange(other._size, 0)) {
+  other._blocks.clear();
+}
+
+ElementList &ElementList::operator=(ElementList &&other) noexcept {
+  _blocks = std::move(other._blocks);
+  _size = std::exchange(other._size, 0);
+  other._blocks.clear();
+  return *this;
+}
+
+Element *ElementList::operator[](size_t position) const {
+  const ElementBlock &block = *_blocks[_blockIndex(position)];
+  return block.elements[position - block.start];
+}
+
+size_t ElementList::_blockIndex(size_t position) const {
+  // Elements are mostly looked up near the end, as they're added
+  if (position >= _blocks.back()->start)
+    return _blocks.size() - 1;
+  auto it = std::upper_bound(_blocks.begin(), _blocks.end(), position,
+                             [](size_t position, const auto &block) {
+                               return position < block->start;
+                             });
+  return std::prev(it) - _blocks.begin();
+}
+
+ElementList::const_iterator ElementList::_iteratorAt(size_t position) const {
+  if (position >= _size)
+    return end();
+  const size_t block = _blockIndex(position);
+  return {_blocks.begin() + block, position - _blocks[block]->start};
+}
+
+void ElementList::push_back(Element *element, std::shared_ptr<Element> owner) {
+  if (_blocks.empty() || _blocks.back()->elements.size() >= _blockSize) {
+    auto block = std::make_unique<ElementBlock>();
+    block->elements.reserve(_blockSize);
+    block->start = _size;
+    _blocks.push_back(std::move(block));
+  }
+
+  ElementBlock &block = *_blocks.back();
+  if (owner || !block.owners.empty()) {
+    if (block.owners.empty()) {
+      block.owners.reserve(_blockSize);
+      block.owners.resize(block.elements.size());
+    }
+    block.owners.push_back(std::move(owner));
+  }
+  element->_block = &block;
+  element->_slot = static_cast<std::uint32_t>(block.elements.size());
+  block.elements.push_back(element);
+  _size++;
+}
+
+std::shared_ptr<Element> ElementList::pop_back() {
+  ElementBlock &block = *_blocks.back();
+  std::shared_ptr<Element> owner;
+  if (!block.owners.empty()) {
+    owner = std::move(block.owners.back());
+    block.owners.pop_back();
+  }
+  block.elements.pop_back();
+  if (block.elements.empty())
+    _blocks.pop_back();
+  _size--;
+  return owner;
+}
+
+void ElementList::replace(size_t position, size_t count, ElementList &with) {
+  const size_t added = with._size;
+  if (_blocks.empty() || (position == _size && added > 2 * _blockSize)) {
+    // Appending plenty: the blocks can move over whole
+    for (auto &block : with._blocks) {
+      block->start = _size;
+      _size += block->elements.size();
+      _blocks.push_back(std::move(block));
+    }
+    with._blocks.clear();
+    with._size = 0;
+    return;
+  }
+
+  // The new elements, with their owners if any of them has one
+  std::vector<Element *> elements;
+  std::vector<std::shared_ptr<Element>> owners;
+  const bool withOwners =
+      std::any_of(with._blocks.begin(), with._blocks.end(),
+                  [](const auto &block) { return !block->owners.empty(); });
+  elements.reserve(added);
+  for (const auto &block : with._blocks) {
+    elements.insert(elements.end(), block->elements.begin(),
+                    block->elements.end());
+    if (!withOwners)
+      continue;
+    if (block->owners.empty())
+      owners.resize(elements.size());
+    else
+      owners.insert(owners.end(),
+                    std::make_move_iterator(block->owners.begin()),
+                    std::make_move_iterator(block->owners.end()));
+  }
+  with._blocks.clear();
+  with._size = 0;
+
+  // Blocks from first to last hold the elements being replaced, or the place
+  // where the new ones go
+  const size_t first = _blockIndex(position);
+  const size_t last = count > 0 ? _blockIndex(position + count - 1) : first;
+  ElementBlock &firstBlock = *_blocks[first];
+  const size_t head = position - firstBlock.start;
+  size_t next = first + 1;
+
+  auto place = [](ElementBlock &block, size_t from) {
+    for (size_t slot = from; slot < block.elements.size(); slot++) {
+      block.elements[slot]->_block = &block;
+      block.elements[slot]->_slot = static_cast<std::uint32_t>(slot);
+    }
+  };
+
+  if (first == last &&
+      firstBlock.elements.size() - count + added <= 2 * _blockSize) {
+    // Splice within the block, only moving the elements after the change
+    ElementBlock &block = firstBlock;
+    if (!owners.empty() && block.owners.empty())
+      block.owners.resize(block.elements.size());
+    if (!block.owners.empty()) {
+      owners.resize(added);
+      auto at = block.owners.erase(block.owners.begin() + head,
+                                   block.owners.begin() + head + count);
+      block.owners.insert(at, std::make_move_iterator(owners.begin()),
+                          std::make_move_iterator(owners.end()));
+    }
+    if (count == added) {
+      std::copy(elements.begin(), elements.end(),
+                block.elements.begin() + head);
+      for (size_t slot = head; slot < head + added; slot++) {
+        block.elements[slot]->_block = &block;
+        block.elements[slot]->_slot = static_cast<std::uint32_t>(slot);
+      }
+    } else {
+      auto at = block.elements.erase(block.elements.begin() + head,
+                                     block.elements.begin() + head + count);
+      block.elements.insert(at, elements.begin(), elements.end());
+      place(block, head);
+    }
+
+    if (block.elements.empty()) {
+      _blocks.erase(_blocks.begin() + first);
+      next = first;
+    }
+  } else {
+    // Gather what's kept of the blocks around the new elements and deal the
+    // lot out over as many blocks as it needs
+    ElementBlock &lastBlock = *_blocks[last];
+    const size_t tail = position + count - lastBlock.start;
+    std::vector<Element *> run;
+    std::vector<std::shared_ptr<Element>> runOwners;
+    const bool owned = !owners.empty() ||
+                       std::any_of(_blocks.begin() + first,
+                                   _blocks.begin() + last + 1,
+                                   [](const auto &block) {
+                                     return !block->owners.empty();
+                                   });
+    auto take = [&](ElementBlock &block, size_t from, size_t to) {
+      run.insert(run.end(), block.elements.begin() + from,
+                 block.elements.begin() + to);
+      if (!owned)
+        return;
+      if (block.owners.empty())
+        runOwners.resize(run.size());
+      else
+        runOwners.insert(runOwners.end(),
+                         std::make_move_iterator(block.owners.begin() + from),
+                         std::make_move_iterator(block.owners.begin() + to));
+    };
+    take(firstBlock, 0, head);
+    run.insert(run.end(), elements.begin(), elements.end());
+    if (owned)
+      owners.resize(added);
+    runOwners.insert(runOwners.end(), std::make_move_iterator(owners.begin()),
+                     std::make_move_iterator(owners.end()));
+    take(lastBlock, tail, lastBlock.elements.size());
+
+    const size_t total = run.size();
+    const size_t blockCount =
+        total == 0 ? 0 : std::max<size_t>(total / _blockSize, 1);
+    const size_t had = last - first + 1;
+    size_t start = firstBlock.start;
+    if (blockCount < had) {
+      _blocks.erase(_blocks.begin() + first + blockCount,
+                    _blocks.begin() + last + 1);
+    } else {
+      for (size_t b = had; b < blockCount; b++)
+        _blocks.insert(_blocks.begin() + first + b,
+                       std::make_unique<ElementBlock>());
+    }
+
+    for (size_t b = 0; b < blockCount; b++) {
+      ElementBlock &block = *_blocks[first + b];
+      const size_t from = b * total / blockCount;
+      const size_t to = (b + 1) * total / blockCount;
+      block.elements.assign(run.begin() + from, run.begin() + to);
+      if (owned)
+        block.owners.assign(std::make_move_iterator(runOwners.begin() + from),
+                            std::make_move_iterator(runOwners.begin() + to));
+      else
+        block.owners.clear();
+      block.start = start;
+      start += to - from;
+      place(block, 0);
+    }
+    next = first + blockCount;
+  }
+
+  _size = _size - count + added;
+  size_t start = next > 0 ? _blocks[next - 1]->start +
+                                _blocks[next - 1]->elements.size()
+                          : 0;
+  for (size_t b = next; b < _blocks.size(); b++) {
+    _blocks[b]->start = start;
+    start += _blocks[b]->elements.size();
+  }
+}
+
+// StringTable
+std::uint32_t StringTable::intern(std::string_view string) {
+  auto it = _ids.find(string);
+  if (it != _ids.end())
+    return it->second;
+
+  std::uint32_t id;
+  if (!_released.empty()) {
+    id = _released.back();
+    _released.pop_back();
+    _strings[id] = string;
+  } else {
+    id = static_cast<std::uint32_t>(_strings.size());
+    _strings.emplace_back(string);
+  }
+  _ids.emplace(_strings[id], id);
+  return id;
+}
+
+void StringTable::release(std::uint32_t id) {
+  _ids.erase(_strings[id]);
+  _strings[id].clear();
+  _released.push_back(id);
+}
+
+std::optional<std::uint32_t> StringTable::find(std::string_view string) const {
+  auto it = _ids.find(string);
+  if (it == _ids.end())
+    return std::nullopt;
+  return it->second;
+}
+
 // Script
 std::string Script::dump() const {
 
   std::vector<std::string> lines;
 
+  auto tagNames = [this](const Element &element) {
+    return join(getTagNames(element), ",");
+  };
+
   for (const auto &titleEntry : _titleEntries) {
-    if (titleEntry->getTags().size() > 0)
-      lines.push_back(titleEntry->dump() +
-                      " tags:" + join(titleEntry->getTags(), ","));
+    if (titleEntry->getTagIds().size() > 0)
+      lines.push_back(titleEntry->dump() + " tags:" + tagNames(*titleEntry));
     else
       lines.push_back(titleEntry->dump());
   }
 
   for (const auto &element : _elements) {
-    if (element->getTags().size() > 0)
-      lines.push_back(element->dump() +
-                      " tags:" + join(element->getTags(), ","));
+    if (element->getTagIds().size() > 0)
+      lines.push_back(element->dump() + " tags:" + tagNames(*element));
     else
       lines.push_back(element->dump());
   }
@@ -109,47 +474,632 @@ std::string Script::dump() const {
   return join(lines, "\n");
 }
 
-void Script::addElement(const std::shared_ptr<Element> &element,
-                        bool allowMerge) {
+TagId Script::internTag(std::string_view name) {
+  if (!_noteNewTags)
+    return _tags.intern(name);
+  if (auto tag = _tags.find(name))
+    return *tag;
+  TagId tag = _tags.intern(name);
+  _newTags.push_back(tag);
+  return tag;
+}
+
+std::vector<std::string> Script::getTagNames(const Element &element) const {
+  std::vector<std::string> names;
+  names.reserve(element.getTagIds().size());
+  for (TagId tag : element.getTagIds())
+    names.push_back(_tags[tag]);
+  return names;
+}
+
+void Script::appendTags(Element &element,
+                        const std::vector<std::string> &names) {
+  std::vector<TagId> tags;
+  tags.reserve(names.size());
+  for (const std::string &name : names)
+    tags.push_back(internTag(name));
+  element.appendTags(tags);
+}
+
+std::vector<Element *>
+Script::getElementsWithTag(std::string_view name) const {
+  std::vector<Element *> result;
+  std::optional<TagId> tag = findTag(name);
+  if (!tag)
+    return result;
+
+  if (*tag < _tagIndex.size()) {
+    result.reserve(_tagIndex[*tag].size() + 1);
+    result.assign(_tagIndex[*tag].begin(), _tagIndex[*tag].end());
+  }
+  if (!_elements.empty() && _elements.back()->hasTag(*tag))
+    result.push_back(_elements.back());
+  return result;
+}
+
+std::vector<Element *> Script::getDialogueFor(CharacterId character) const {
+  if (character < _dialogueIndex.size())
+    return _dialogueIndex[character];
+  return {};
+}
+
+const Scene *Script::findScene(std::string_view sceneNumber) const {
+  auto [begin, end] = _sceneNumbers.equal_range(sceneNumber);
+  if (begin == end)
+    return nullptr;
+
+  size_t first = SIZE_MAX;
+  for (auto it = begin; it != end; ++it)
+    first = std::min(first, _elements.positionOf(*it->second));
+  return &_scenes[_firstSceneFrom(first)];
+}
+
+const Scene *Script::getSceneAt(size_t position) const {
+  const size_t next = _firstSceneFrom(position + 1);
+  if (next == 0 || position > _elements.positionOf(*_scenes[next - 1].last))
+    return nullptr;
+  return &_scenes[next - 1];
+}
 
-  std::shared_ptr<Element> lastElem = getLastElement();
+size_t Script::_firstSceneFrom(size_t position) const {
+  auto it = std::lower_bound(_scenes.begin(), _scenes.end(), position,
+                             [this](const Scene &scene, size_t position) {
+                               return _elements.positionOf(*scene.heading) <
+                                      position;
+                             });
+  return it - _scenes.begin();
+}
 
-  if (element->getType() == ElementType::CHARACTER) {
-    std::shared_ptr<Character> charElem =
-        std::dynamic_pointer_cast<Character>(element);
-    std::string newChar =
-        charElem->getName() + (charElem->getExtension().has_value()
-                                   ? charElem->getExtension().value()
-                                   : "");
-    if (allowMerge && _lastChar == newChar)
+void Script::_eraseSceneNumber(const SceneHeading &heading) {
+  if (!heading.getSceneNumber().has_value())
+    return;
+  auto [begin, end] = _sceneNumbers.equal_range(*heading.getSceneNumber());
+  for (auto it = begin; it != end; ++it) {
+    if (it->second == &heading) {
+      _sceneNumbers.erase(it);
       return;
-    _lastChar = newChar;
+    }
   }
+}
 
-  else if (element->getType() == ElementType::DIALOGUE) {
-    if (allowMerge && lastElem &&
-        lastElem->getType() == ElementType::DIALOGUE) {
-      lastElem->appendLine(element->getTextRaw());
+namespace {
+
+// Adds an element to a scene index that has got as far as `scenes`. outline is
+// what the next scene comes under, and inScene whether the last scene is
+// still taking elements.
+void indexScene(Element *element, std::vector<Scene> &scenes,
+                std::vector<Element *> &outline, bool &inScene) {
+  switch (element->getType()) {
+  case ElementType::HEADING:
+    scenes.push_back({static_cast<SceneHeading *>(element), element, outline});
+    inScene = true;
+    return;
+
+  case ElementType::SECTION: {
+    // Close any sections at the same level or deeper, with their synopses
+    const int level = static_cast<const Section &>(*element).getLevel();
+    for (;;) {
+      auto section = std::find_if(
+          outline.rbegin(), outline.rend(), [](const Element *outlined) {
+            return outlined->getType() == ElementType::SECTION;
+          });
+      if (section == outline.rend() ||
+          static_cast<const Section &>(**section).getLevel() < level)
+        break;
+      outline.erase(std::prev(section.base()), outline.end());
+    }
+    outline.push_back(element);
+    inScene = false;
+    return;
+  }
+
+  case ElementType::SYNOPSIS:
+    // Between a section and its first scene, a synopsis is the section's
+    if (!inScene) {
+      outline.push_back(element);
       return;
     }
+    break;
+
+  default:
+    break;
   }
 
-  else if (element->getType() == ElementType::PARENTHETICAL) {
-    //
+  if (inScene)
+    scenes.back().last = element;
+}
+
+} // namespace
+
+void Script::_indexScene(Element *element) {
+  indexScene(element, _scenes, _outline, _inScene);
+
+  if (element->getType() == ElementType::HEADING) {
+    auto &heading = static_cast<SceneHeading &>(*element);
+    if (heading.getSceneNumber().has_value())
+      _sceneNumbers.emplace(*heading.getSceneNumber(), &heading);
   }
+}
 
-  else {
-    _lastChar = "";
+std::optional<CharacterId> Script::_speakerAt(size_t position) const {
+  std::optional<CharacterId> speaker;
+  for (size_t i = std::min(position, _elements.size()); i-- > 0;) {
+    const Element &element = *_elements[i];
+    ElementType type = element.getType();
+    if (type == ElementType::CHARACTER)
+      speaker = static_cast<const Character &>(element).getCharacterId();
+    if (type != ElementType::DIALOGUE && type != ElementType::PARENTHETICAL)
+      break;
   }
+  return speaker;
+}
 
-  if (element->getType() == ElementType::ACTION) {
-    if (allowMerge && lastElem && lastElem->getType() == ElementType::ACTION) {
-      lastElem->appendLine(element->getTextRaw());
-      return;
+CueId Script::_internCue(std::string_view name, std::string_view extension) {
+  CharacterId character = _characters.intern(name);
+  if (_keepIndexes && character >= _dialogueIndex.size())
+    _dialogueIndex.resize(character + 1);
+
+  std::uint32_t extensionId = _extensions.intern(extension);
+  std::uint64_t key = std::uint64_t(character) << 32 | extensionId;
+  auto it = _cueIds.find(key);
+  if (it != _cueIds.end())
+    return it->second;
+
+  CueId cue;
+  if (!_releasedCues.empty()) {
+    cue = _releasedCues.back();
+    _releasedCues.pop_back();
+    _cues[cue] = {character, extensionId};
+  } else {
+    cue = static_cast<CueId>(_cues.size());
+    _cues.push_back({character, extensionId});
+  }
+  _cueIds.emplace(key, cue);
+
+  if (character >= _characterCues.size())
+    _characterCues.resize(character + 1);
+  _characterCues[character]++;
+  if (extensionId >= _extensionCues.size())
+    _extensionCues.resize(extensionId + 1);
+  _extensionCues[extensionId]++;
+  return cue;
+}
+
+void Script::_internCue(Character &character) {
+  character._cueId = _internCue(character._name,
+                                character._extension.value_or(std::string()));
+  character._characterId = _cues[character._cueId].character;
+}
+
+void Script::_releaseCue(CueId cue) {
+  Cue &entry = _cues[cue];
+  if (--entry.uses > 0)
+    return;
+
+  _cueIds.erase(std::uint64_t(entry.character) << 32 | entry.extension);
+  if (--_characterCues[entry.character] == 0)
+    _characters.release(entry.character);
+  if (--_extensionCues[entry.extension] == 0)
+    _extensions.release(entry.extension);
+  _releasedCues.push_back(cue);
+}
+
+void Script::_reindexFrom(size_t position) {
+  auto from = [&](const Element *element) {
+    return _elements.positionOf(*element) >= position;
+  };
+  for (auto &elements : _tagIndex) {
+    while (!elements.empty() && from(elements.back()))
+      elements.pop_back();
+  }
+  for (auto &elements : _dialogueIndex) {
+    while (!elements.empty() && from(elements.back()))
+      elements.pop_back();
+  }
+
+  // Scenes are rebuilt from the last one that starts before `position`, as
+  // that's where the outline was last known.
+  while (!_scenes.empty() && from(_scenes.back().heading)) {
+    _eraseSceneNumber(*_scenes.back().heading);
+    _scenes.pop_back();
+  }
+
+  size_t i = 0;
+  _outline.clear();
+  _inScene = false;
+  if (!_scenes.empty()) {
+    Scene &scene = _scenes.back();
+    _outline = scene.outline;
+    _inScene = true;
+    scene.last = scene.heading;
+    i = _elements.positionOf(*scene.heading) + 1;
+  }
+  auto it = _elements._iteratorAt(i);
+  for (; i < position && it != _elements.end(); i++, ++it)
+    indexScene(*it, _scenes, _outline, _inScene);
+
+  std::optional<CharacterId> speaker = _speakerAt(position);
+  for (; it != _elements.end(); i++, ++it) {
+    Element *element = *it;
+    if (i + 1 < _elements.size()) {
+      for (TagId tag : element->getTagIds()) {
+        if (tag >= _tagIndex.size())
+          _tagIndex.resize(tag + 1);
+        _tagIndex[tag].push_back(element);
+      }
     }
+
+    _indexScene(element);
+
+    switch (element->getType()) {
+    case ElementType::CHARACTER:
+      speaker = static_cast<Character &>(*element).getCharacterId();
+      break;
+    case ElementType::DIALOGUE:
+    case ElementType::PARENTHETICAL:
+      if (speaker)
+        _dialogueIndex[*speaker].push_back(element);
+      break;
+    default:
+      speaker.reset();
+    }
+  }
+}
+
+size_t Script::_replaceElements(size_t position, size_t count,
+                                ElementList &elements) {
+  const size_t oldSize = _elements.size();
+  const size_t end = position + count;
+  const size_t added = elements.size();
+  const size_t newSize = oldSize - count + added;
+  size_t looked = count + added;
+
+  if (!_keepIndexes) {
+    _elements.replace(position, count, elements);
+    return looked;
+  }
+  if (_tagIndex.size() < _tags.size())
+    _tagIndex.resize(_tags.size());
+  if (_dialogueIndex.size() < _characters.size())
+    _dialogueIndex.resize(_characters.size());
+
+  // The stretch whose index entries change, as it is and as it will be. When
+  // the change reaches the end, the element before it is last either before
+  // or after, and the last element isn't in the tag index, so it's taken in.
+  // So is any dialogue straight after the change, as its speaker may change.
+  const size_t from = end == oldSize && position > 0 ? position - 1 : position;
+  std::vector<Element *> before;
+  auto it = _elements._iteratorAt(from);
+  for (size_t i = from; i < end; i++, ++it)
+    before.push_back(*it);
+  std::vector<Element *> after(before.begin(),
+                               before.begin() + (position - from));
+  after.insert(after.end(), elements.begin(), elements.end());
+  const size_t beforeTagged = before.empty() ? 0 : before.size() -
+                                                       (end == oldSize ? 1 : 0);
+  const size_t afterTagged = after.empty() ? 0 : after.size() -
+                                                     (end == oldSize ? 1 : 0);
+
+  size_t through = end;
+  for (; it != _elements.end(); ++it, through++) {
+    ElementType type = (*it)->getType();
+    if (type != ElementType::DIALOGUE && type != ElementType::PARENTHETICAL)
+      break;
+    before.push_back(*it);
+    after.push_back(*it);
   }
+  looked += (position - from) + (through - end);
+
+  // Entries as (tag or character, element), in index order
+  using Entry = std::pair<std::uint32_t, Element *>;
+  auto sorted = [](std::vector<Entry> entries) {
+    std::stable_sort(
+        entries.begin(), entries.end(),
+        [](const Entry &a, const Entry &b) { return a.first < b.first; });
+    return entries;
+  };
+  auto tagEntries = [&](const std::vector<Element *> &stretch, size_t count) {
+    std::vector<Entry> entries;
+    for (size_t i = 0; i < count; i++) {
+      for (TagId tag : stretch[i]->getTagIds())
+        entries.emplace_back(tag, stretch[i]);
+    }
+    return sorted(std::move(entries));
+  };
+  const std::optional<CharacterId> speaker = _speakerAt(from);
+  auto dialogueEntries = [&](const std::vector<Element *> &stretch) {
+    std::vector<Entry> entries;
+    std::optional<CharacterId> current = speaker;
+    for (Element *element : stretch) {
+      switch (element->getType()) {
+      case ElementType::CHARACTER:
+        current = static_cast<Character &>(*element).getCharacterId();
+        break;
+      case ElementType::DIALOGUE:
+      case ElementType::PARENTHETICAL:
+        if (current)
+          entries.emplace_back(*current, element);
+        break;
+      default:
+        current.reset();
+      }
+    }
+    return sorted(std::move(entries));
+  };
+
+  // Each list is in script order, so the old stretch's entries in it are a
+  // run, found by position, which the new stretch's entries take the place of
+  auto replaceRuns = [&](std::vector<std::vector<Element *>> &index,
+                         const std::vector<Entry> &removed,
+                         const std::vector<Entry> &adding, size_t to) {
+    auto byPosition = [this](const Element *element, size_t position) {
+      return _elements.positionOf(*element) < position;
+    };
+    auto r = removed.begin();
+    auto a = adding.begin();
+    std::vector<Element *> run;
+    while (r != removed.end() || a != adding.end()) {
+      const std::uint32_t key =
+          std::min(r != removed.end() ? r->first : UINT32_MAX,
+                   a != adding.end() ? a->first : UINT32_MAX);
+      while (r != removed.end() && r->first == key)
+        r++;
+      run.clear();
+      for (; a != adding.end() && a->first == key; a++)
+        run.push_back(a->second);
+
+      std::vector<Element *> &list = index[key];
+      auto first = std::lower_bound(list.begin(), list.end(), from, byPosition);
+      auto last = std::lower_bound(first, list.end(), to, byPosition);
+      if (static_cast<size_t>(last - first) == run.size())
+        std::copy(run.begin(), run.end(), first);
+      else
+        list.insert(list.erase(first, last), run.begin(), run.end());
+    }
+  };
+  replaceRuns(_tagIndex, tagEntries(before, beforeTagged),
+              tagEntries(after, afterTagged), end);
+  replaceRuns(_dialogueIndex, dialogueEntries(before),
+              dialogueEntries(after), through);
+
+  // Scenes headed in the old stretch go. The one before it is replayed, and
+  // if it ran on past the change, it still ends where it did unless the new
+  // elements end it.
+  const size_t s0 = _firstSceneFrom(position);
+  const size_t s1 = _firstSceneFrom(end);
+  for (size_t s = s0; s < s1; s++)
+    _eraseSceneNumber(*_scenes[s].heading);
+  Element *runsOnTo = nullptr;
+  if (s0 > 0 && _elements.positionOf(*_scenes[s0 - 1].last) >= end)
+    runsOnTo = _scenes[s0 - 1].last;
+
+  _elements.replace(position, count, elements);
 
-  _elements.push_back(element);
+  std::vector<Scene> scenes;
+  std::vector<Element *> outline;
+  bool inScene = false;
+  size_t i = 0;
+  if (s0 > 0) {
+    Scene &scene = _scenes[s0 - 1];
+    scene.last = scene.heading;
+    outline = scene.outline;
+    inScene = true;
+    i = _elements.positionOf(*scene.heading) + 1;
+    scenes.push_back(std::move(scene));
+  }
+
+  // Past the new elements, the old scenes hold again from the first heading
+  // whose outline comes out the same
+  const size_t changeEnd = position + added;
+  size_t next = s1;
+  for (it = _elements._iteratorAt(i); i < newSize; i++, ++it) {
+    Element *element = *it;
+    if (i >= changeEnd) {
+      if (runsOnTo && inScene && scenes.size() == 1) {
+        scenes.back().last = runsOnTo;
+        break;
+      }
+      if (element->getType() == ElementType::HEADING) {
+        if (_scenes[next].outline == outline)
+          break;
+        next++;
+      }
+    }
+    indexScene(element, scenes, outline, inScene);
+    looked++;
+  }
+  if (i == newSize) {
+    _outline = std::move(outline);
+    _inScene = inScene;
+  }
+
+  const size_t firstScene = s0 > 0 ? s0 - 1 : 0;
+  auto at = _scenes.begin() + firstScene;
+  if (next - firstScene == scenes.size()) {
+    std::move(scenes.begin(), scenes.end(), at);
+  } else {
+    at = _scenes.erase(at, _scenes.begin() + next);
+    _scenes.insert(at, std::make_move_iterator(scenes.begin()),
+                   std::make_move_iterator(scenes.end()));
+  }
+  for (size_t s = firstScene; s < firstScene + scenes.size(); s++) {
+    SceneHeading &heading = *_scenes[s].heading;
+    const size_t headingAt = _elements.positionOf(heading);
+    if (headingAt >= position && headingAt < changeEnd &&
+        heading.getSceneNumber().has_value())
+      _sceneNumbers.emplace(*heading.getSceneNumber(), &heading);
+  }
+  return looked;
+}
+
+std::vector<std::optional<TagId>>
+Script::_renumberTags(const std::vector<Element *> &waiting) {
+  StringTable oldTags = std::move(_tags);
+  _tags = StringTable();
+
+  std::vector<std::optional<TagId>> ids(oldTags.size());
+  auto retag = [&](Element &element) {
+    for (TagId &tag : element._tags) {
+      std::optional<TagId> &id = ids[tag];
+      if (!id)
+        id = _tags.intern(oldTags[tag]);
+      tag = *id;
+    }
+  };
+  for (const auto &titleEntry : _titleEntries)
+    retag(*titleEntry);
+  for (const auto &element : _elements)
+    retag(*element);
+  for (Element *element : waiting)
+    retag(*element);
+
+  // Positions don't change, so the index just moves over to the new ids
+  std::vector<std::vector<Element *>> tagIndex(_tags.size());
+  for (size_t tag = 0; tag < _tagIndex.size(); tag++) {
+    if (ids[tag])
+      tagIndex[*ids[tag]] = std::move(_tagIndex[tag]);
+  }
+  _tagIndex = std::move(tagIndex);
+  return ids;
+}
+
+bool Script::_isTagUsed(TagId tag) const {
+  if (tag < _tagIndex.size() && !_tagIndex[tag].empty())
+    return true;
+  if (!_elements.empty() && _elements.back()->hasTag(tag))
+    return true;
+  return std::any_of(_titleEntries.begin(), _titleEntries.end(),
+                     [tag](const auto &entry) { return entry->hasTag(tag); });
+}
+
+void Script::_importTags(Element &element, const Script &from) {
+  for (TagId &tag : element._tags)
+    tag = internTag(from._tags[tag]);
+}
+
+Element *Script::addElement(Element &&element, bool allowMerge) {
+  if (_prepareToAdd(element, allowMerge))
+    return nullptr;
+  Element *added = _pushElement(std::move(element));
+  _indexAdded(added);
+  return added;
+}
+
+void Script::addElement(const std::shared_ptr<Element> &element,
+                        bool allowMerge) {
+  if (_prepareToAdd(*element, allowMerge))
+    return;
+  _elements.push_back(element.get(), element);
+  _indexAdded(element.get());
+}
+
+bool Script::_prepareToAdd(Element &element, bool allowMerge) {
+
+  Element *lastElem = _elements.empty() ? nullptr : _elements.back();
+
+  // Adds the element's text to the last one instead, if they're the same type
+  auto merge = [&](const Element &elem) {
+    if (!allowMerge || !lastElem || lastElem->getType() != elem.getType())
+      return false;
+    lastElem->appendLine(elem.getTextRaw());
+    return true;
+  };
+
+  // Returns true if the element was merged into the last one, so there's
+  // nothing more to do
+  auto mergeElement = overloaded{
+      [&](Character &character) {
+        _internCue(character);
+        if (allowMerge && _lastCue == character.getCueId())
+          return true;
+        _lastCue = character.getCueId();
+        _useCue(character.getCueId());
+        return false;
+      },
+      [&](const Dialogue &dialogue) { return merge(dialogue); },
+      [](const Parenthetical &) { return false; },
+      [&](const Action &action) {
+        _lastCue.reset();
+        return merge(action);
+      },
+      [&](const Element &) {
+        _lastCue.reset();
+        return false;
+      }};
+
+  if (visit(element, mergeElement))
+    return true;
+
+  // The old last element is settled now, so it can go in the tag index
+  if (lastElem && _keepIndexes) {
+    for (TagId tag : lastElem->getTagIds()) {
+      if (tag >= _tagIndex.size())
+        _tagIndex.resize(tag + 1);
+      _tagIndex[tag].push_back(lastElem);
+    }
+  }
+  return false;
+}
+
+void Script::_indexAdded(Element *element) {
+  if (!_keepIndexes)
+    return;
+  if ((element->getType() == ElementType::DIALOGUE ||
+       element->getType() == ElementType::PARENTHETICAL) &&
+      _lastCue) {
+    _dialogueIndex[_cues[*_lastCue].character].push_back(element);
+  }
+  _indexScene(element);
+}
+
+Element *Script::_pushElement(Element &&element) {
+  visit(element, [this](auto &concrete) {
+    using T = std::remove_reference_t<decltype(concrete)>;
+    if (_arena) {
+      _elements.push_back(_arena->create<T>(std::move(concrete)));
+    } else {
+      auto owner = std::make_shared<T>(std::move(concrete));
+      T *added = owner.get();
+      _elements.push_back(added, std::move(owner));
+    }
+  });
+  return _elements.back();
+}
+
+void Script::_appendElements(Script &from) {
+  if (!_arena)
+    from._dropArena();
+  else if (from._arena)
+    _arena->adopt(*from._arena);
+
+  for (Element *element : from._elements) {
+    if (element->getType() != ElementType::CHARACTER)
+      continue;
+    auto &character = static_cast<Character &>(*element);
+    _internCue(character);
+    _useCue(character.getCueId());
+  }
+
+  _elements.replace(_elements.size(), 0, from._elements);
+}
+
+void Script::_dropArena() {
+  if (!_arena)
+    return;
+  for (auto &block : _elements._blocks) {
+    block->owners.resize(block->elements.size());
+    for (size_t slot = 0; slot < block->elements.size(); slot++) {
+      if (block->owners[slot])
+        continue;
+      // The copy takes the element's place, block and slot along with it
+      visit(*block->elements[slot], [&](auto &concrete) {
+        using T = std::remove_reference_t<decltype(concrete)>;
+        block->owners[slot] = std::make_shared<T>(std::move(concrete));
+      });
+      block->elements[slot] = block->owners[slot].get();
+    }
+  }
+  _arena.reset();
 }
 
 } // namespace ScreenplayTools
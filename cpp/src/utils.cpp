@@ -15,6 +15,15 @@ std::string trim(const std::string &str) {
   return str.substr(start, end - start + 1);
 }
 
+std::string_view trimView(std::string_view str) {
+  const std::string_view whitespace = " \t\r\n";
+  size_t start = str.find_first_not_of(whitespace);
+  if (start == std::string_view::npos)
+    return {};
+  size_t end = str.find_last_not_of(whitespace);
+  return str.substr(start, end - start + 1);
+}
+
 std::string trimOuterNewlines(const std::string &str) {
   return std::regex_replace(str, std::regex(R"((^\r?\n+)|(\r?\n+$))"), "");
 }
@@ -29,7 +38,7 @@ std::string replaceAll(std::string str, const std::string &from,
   return str;
 }
 
-bool isWhitespaceOrEmpty(const std::string &str) {
+bool isWhitespaceOrEmpty(std::string_view str) {
   return std::all_of(str.begin(), str.end(),
                      [](unsigned char c) { return std::isspace(c); });
 }
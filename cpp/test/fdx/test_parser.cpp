@@ -6,6 +6,7 @@
 #include "screenplay_tools/fdx/parser.h"
 #include "screenplay_tools/fdx/writer.h"
 #include "screenplay_tools/fountain/parser.h"
+#include <filesystem>
 #include <fstream>
 
 using namespace ScreenplayTools;
@@ -33,6 +34,15 @@ TEST_CASE("FDX Parser", "[fdx]") {
     CHECK(first->getText() == "INT. RADIO STUDIO");
   }
 
+  SECTION("ParseFile matches Parse") {
+    std::string fdxContent = loadTestFile("../tests/TestFDX-FD.fdx");
+    FDX::Parser parser;
+    Script script = parser.Parse(fdxContent);
+    Script mapped = parser.ParseFile(testFilePath("TestFDX-FD.fdx"));
+
+    CHECK(mapped.dump() == script.dump());
+  }
+
   SECTION("Round Trip") {
     std::string fdxContent = loadTestFile("../tests/TestFDX-FD.fdx");
     FDX::Parser parser;
@@ -94,8 +104,8 @@ TEST_CASE("FDX Parser", "[fdx]") {
       parserFountain.finalizeParsing();
       const Script &scriptFountain = *parserFountain.getScript();
 
-      auto elsFDX = scriptFDX.getElements();
-      auto elsFountain = scriptFountain.getElements();
+      const auto &elsFDX = scriptFDX.getElements();
+      const auto &elsFountain = scriptFountain.getElements();
 
       // Check sizes
       // Note: FDX parsing might produce slightly different element counts if
@@ -122,4 +132,71 @@ TEST_CASE("FDX Parser", "[fdx]") {
       }
     }
   }
+
+  SECTION("Markup around paragraphs") {
+    const std::string fdx =
+        "<?xml version=\"1.0\"?>\n"
+        "<!DOCTYPE FinalDraft>\n"
+        "<FinalDraft Version=\"1\">\n"
+        "  <!-- <Paragraph Type=\"Action\"> -->\n"
+        "  <Content>\n"
+        "    <Paragraph Number=\"1\" Type=\"Scene Heading\">\n"
+        "      <SceneProperties Title=\"a > b\"/>\n"
+        "      <Text>INT. </Text><Text Style=\"Bold\">HOUSE</Text>\n"
+        "    </Paragraph>\n"
+        "    <Paragraph Type='Character'>\n"
+        "      <Text><![CDATA[BOB]]> (V.O.)</Text>\n"
+        "    </Paragraph>\n"
+        "    <Paragraph>\n"
+        "      <DualDialogue><Paragraph Type=\"Dialogue\"><Text>Hidden</Text>"
+        "</Paragraph></DualDialogue>\n"
+        "      <Text>Untyped</Text>\n"
+        "    </Paragraph>\n"
+        "    <Paragraph Type=\"Dialogue\">\n"
+        "      <Text>Cut off";
+
+    Script script = FDX::Parser().Parse(fdx);
+    const auto &elements = script.getElements();
+    REQUIRE(elements.size() == 4);
+    CHECK(elements[0]->getType() == ElementType::HEADING);
+    CHECK(elements[0]->getText() == "INT. HOUSE");
+    const auto &character = static_cast<const Character &>(*elements[1]);
+    CHECK(character.getName() == "BOB");
+    CHECK(character.getExtension() == "V.O.");
+    CHECK(elements[2]->getType() == ElementType::ACTION);
+    CHECK(elements[2]->getText() == "Untyped");
+    CHECK(elements[3]->getType() == ElementType::DIALOGUE);
+    CHECK(elements[3]->getText() == "Cut off");
+  }
+
+  SECTION("Entities") {
+    const std::string fdx =
+        "<FinalDraft><Content>\n"
+        "<Paragraph Type=\"Action\"><Text>Fish &amp; chips &lt;hot&gt; "
+        "&quot;now&quot; &apos;n&apos; caf&#233; caf&#xE9; &#x1F600;</Text>"
+        "</Paragraph>\n"
+        "<Paragraph Type=\"Action\"><Text>&nope; &#0; &#xD800; AT&T &amp"
+        "</Text></Paragraph>\n"
+        "<Paragraph Type=\"Scene&#32;Heading\"><Text><![CDATA[&amp;]]>"
+        "</Text></Paragraph>\n"
+        "</Content></FinalDraft>\n";
+
+    Script script = FDX::Parser().Parse(fdx);
+    const auto &elements = script.getElements();
+    REQUIRE(elements.size() == 3);
+    CHECK(elements[0]->getTextRaw() ==
+          "Fish & chips <hot> \"now\" 'n' caf\xC3\xA9 caf\xC3\xA9 "
+          "\xF0\x9F\x98\x80");
+    // Anything that isn't a valid reference is left as it is
+    CHECK(elements[1]->getTextRaw() == "&nope; &#0; &#xD800; AT&T &amp");
+    CHECK(elements[2]->getType() == ElementType::HEADING);
+    CHECK(elements[2]->getTextRaw() == "&amp;");
+
+    // And the writer escapes them again
+    Script reparsed = FDX::Parser().Parse(FDX::Writer().Write(script));
+    REQUIRE(reparsed.getElements().size() == 3);
+    for (size_t i = 0; i < 3; i++)
+      CHECK(reparsed.getElements()[i]->getTextRaw() ==
+            elements[i]->getTextRaw());
+  }
 }
@@ -0,0 +1,119 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "../catch_amalgamated.hpp"
+#include "../test_utils.h"
+#include "corpus.h"
+#include "screenplay_tools/fdx/parser.h"
+#include "screenplay_tools/fdx/stream_parser.h"
+#include "screenplay_tools/fdx/writer.h"
+
+using namespace ScreenplayTools;
+
+TEST_CASE("FDX StreamParser", "[fdx]") {
+  CorpusOptions options;
+  options.lines = 2000;
+  options.longLineChance = 5;
+  options.longLineLength = 10000;
+
+  const std::string fixture = loadTestFile("../tests/TestFDX-FD.fdx");
+  const std::string corpus = generateCorpus(options).fdx;
+
+  SECTION("Chunks of any size give what Parse() does") {
+    for (const std::string &fdx : {fixture, corpus}) {
+      const Script whole = FDX::Parser().Parse(fdx);
+      const std::string expected = FDX::Writer().Write(whole);
+
+      for (size_t chunkSize : {1, 7, 4096}) {
+        FDX::StreamParser stream;
+        stream.keepElements = true;
+        for (size_t pos = 0; pos < fdx.size(); pos += chunkSize)
+          stream.AddChunk(std::string_view(fdx).substr(pos, chunkSize));
+        stream.Finish();
+        REQUIRE(FDX::Writer().Write(stream.GetScript()) == expected);
+      }
+    }
+  }
+
+  SECTION("Elements are handed on in order") {
+    const Script whole = FDX::Parser().Parse(corpus);
+    const auto &expected = whole.getElements();
+
+    size_t count = 0;
+    size_t maxBuffered = 0;
+    FDX::StreamParser stream;
+    stream.onElement = [&](const Element &element) {
+      REQUIRE(count < expected.size());
+      CHECK(element.getType() == expected[count]->getType());
+      CHECK(element.getTextRaw() == expected[count]->getTextRaw());
+      count++;
+    };
+    for (size_t pos = 0; pos < corpus.size(); pos += 1000) {
+      stream.AddChunk(std::string_view(corpus).substr(pos, 1000));
+      maxBuffered = std::max(maxBuffered, stream.GetBufferedSize());
+    }
+    stream.Finish();
+
+    CHECK(count == expected.size());
+    CHECK(stream.GetScript().getElements().empty());
+    // Only part of a tag is ever held back, never a whole paragraph
+    CHECK(maxBuffered < 200);
+  }
+
+  SECTION("Entities split between chunks are decoded") {
+    const std::string fdx =
+        "<FinalDraft><Content><Paragraph><Text>Fish &amp; chips, "
+        "caf&#xE9; AT&T &#65;</Text></Paragraph></Content></FinalDraft>";
+    const std::string expected = FDX::Writer().Write(FDX::Parser().Parse(fdx));
+
+    FDX::StreamParser stream;
+    stream.keepElements = true;
+    for (char c : fdx)
+      stream.AddChunk(std::string_view(&c, 1));
+    stream.Finish();
+    REQUIRE(stream.GetScript().getElements().size() == 1);
+    CHECK(stream.GetScript().getElements()[0]->getTextRaw() ==
+          "Fish & chips, caf\xC3\xA9 AT&T A");
+    CHECK(FDX::Writer().Write(stream.GetScript()) == expected);
+  }
+
+  SECTION("Skipped markup isn't held back however long it is") {
+    const std::string filler(200000, 'x');
+    const std::string fdx =
+        "<?xml version=\"1.0\"?><!-- " + filler +
+        " --><FinalDraft><Data><![CDATA[" + filler +
+        "]]></Data><Data a=\"/>" + filler + "\" b='" + filler +
+        "'/><Data a='" + filler + "/'>Skipped</Data " + filler +
+        "><Content><?note " + filler +
+        " ?><Paragraph Type=\"Action\"><Text><![CDATA[" + filler +
+        "]]]]>&amp;<![CDATA[ <not a tag>]]></Text></Paragraph></Content>"
+        "</FinalDraft>";
+    const Script whole = FDX::Parser().Parse(fdx);
+    REQUIRE(whole.getElements().size() == 1);
+    CHECK(whole.getElements()[0]->getTextRaw() == filler + "]]& <not a tag>");
+    const std::string expected = FDX::Writer().Write(whole);
+
+    for (size_t chunkSize : {1, 2, 3, 1000}) {
+      size_t maxBuffered = 0;
+      FDX::StreamParser stream;
+      stream.keepElements = true;
+      for (size_t pos = 0; pos < fdx.size(); pos += chunkSize) {
+        stream.AddChunk(std::string_view(fdx).substr(pos, chunkSize));
+        maxBuffered = std::max(maxBuffered, stream.GetBufferedSize());
+      }
+      stream.Finish();
+      CHECK(FDX::Writer().Write(stream.GetScript()) == expected);
+      CHECK(maxBuffered < 30);
+    }
+  }
+
+  SECTION("A document that's cut off keeps its last paragraph") {
+    FDX::StreamParser stream;
+    stream.keepElements = true;
+    stream.AddChunk("<FinalDraft><Content><Paragraph Type=\"Action\"><Text>");
+    stream.AddChunk("Cut off");
+    stream.Finish();
+    REQUIRE(stream.GetScript().getElements().size() == 1);
+    CHECK(stream.GetScript().getElements()[0]->getText() == "Cut off");
+  }
+}
@@ -0,0 +1,33 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "../catch_amalgamated.hpp"
+#include "../test_utils.h"
+#include "corpus.h"
+#include "screenplay_tools/fdx/writer.h"
+#include "screenplay_tools/fountain/parser.h"
+
+using namespace ScreenplayTools;
+
+TEST_CASE("FDX MeasuredWrite", "[fdx]") {
+  CorpusOptions options;
+  options.lines = 2000;
+  options.noteChance = 30;
+  options.boneyardChance = 30;
+  Fountain::Parser fp;
+  fp.addText(loadTestFile("TitlePage.fountain"));
+  fp.addText(generateCorpus(options).fountain);
+  fp.addText(loadTestFile("UTF8.fountain"));
+  const Script &script = *fp.getScript();
+
+  FDX::Writer fw;
+  const std::string match = fw.Write(script);
+  REQUIRE(fw.Measure(script) == match.size());
+
+  std::string buffer(match.size(), '\0');
+  REQUIRE(fw.Write(script, buffer) == match.size());
+  REQUIRE(buffer == match);
+
+  buffer.pop_back();
+  REQUIRE_THROWS_AS(fw.Write(script, buffer), std::length_error);
+}
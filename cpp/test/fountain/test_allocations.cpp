@@ -0,0 +1,70 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "../catch_amalgamated.hpp"
+#include "screenplay_tools/fountain/parser.h"
+#include <cstdlib>
+#include <new>
+
+using namespace ScreenplayTools;
+
+// Counts heap allocations made while counting is switched on. Replacing the
+// global operator new affects the whole program, so these tests are built
+// into an executable of their own.
+namespace {
+bool counting = false;
+size_t allocations = 0;
+} // namespace
+
+void *operator new(size_t size) {
+  if (counting)
+    allocations++;
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+TEST_CASE("AddLineAllocations") {
+
+  // Text short enough for every element to fit it in place, merged or not, so
+  // anything allocated is down to the parser.
+  const std::vector<std::string> lines = {
+      "INT. HOUSE", "",       "Bob walks in.", "",         "BOB (CONT'D)",
+      "(quietly)",  "Hi.",    "",              "ALICE ^",  "Hello.",
+      "Bye.",       "",       "CUT TO:",       "",         "!Bang.",
+      "Tag #tag",   "",       "> Centered <",  "",         "~Lyric",
+      ""};
+
+  for (bool useTags : {false, true}) {
+    for (bool merge : {false, true}) {
+      Fountain::Parser fp;
+      fp.useTags = useTags;
+      fp.mergeActions = merge;
+      fp.mergeDialogue = merge;
+
+      // Warm up, so the parser's own buffers have reached their sizes
+      fp.addLine("Title: Allocations");
+      fp.addLine("");
+      for (int i = 0; i < 10; i++)
+        fp.addLines(lines);
+
+      const int repeats = 1000;
+      allocations = 0;
+      counting = true;
+      for (int i = 0; i < repeats; i++) {
+        for (const auto &line : lines)
+          fp.addLine(line);
+      }
+      counting = false;
+
+      // The one tagged element's list of tags is stored in it. Otherwise only
+      // the growing element list and arena allocate, and not on every line.
+      const size_t stored = useTags ? repeats : 0;
+      INFO("useTags:" << useTags << " merge:" << merge);
+      REQUIRE(allocations < stored + repeats / 10);
+    }
+  }
+}
@@ -3,6 +3,7 @@
 
 #include "../catch_amalgamated.hpp"
 #include "../test_utils.h"
+#include "screenplay_tools/fountain/basic_callback_parser.h"
 #include "screenplay_tools/fountain/callback_parser.h"
 #include "screenplay_tools/utils.h"
 #include <iostream>
@@ -17,14 +18,8 @@ std::string asNull(const std::optional<std::string> value) {
 
 std::string asBool(const bool value) { return value ? "true" : "false"; }
 
-TEST_CASE("CallbackParser") {
-
-  const std::string match = loadTestFile("SimpleCallbackParser.txt");
-
-  std::ostringstream oss;
-
-  Fountain::CallbackParser fp;
-
+// Logs every callback to oss.
+void logCallbacks(Fountain::CallbackParser &fp, std::ostringstream &oss) {
   fp.onDialogue = [&oss](const std::string &character,
                          const std::optional<std::string> extension,
                          const std::optional<std::string> parenthetical,
@@ -71,6 +66,16 @@ TEST_CASE("CallbackParser") {
         }
         oss << std::endl;
       };
+}
+
+TEST_CASE("CallbackParser") {
+
+  const std::string match = loadTestFile("SimpleCallbackParser.txt");
+
+  std::ostringstream oss;
+
+  Fountain::CallbackParser fp;
+  logCallbacks(fp, oss);
 
   fp.ignoreBlanks = true;
 
@@ -81,4 +86,165 @@ TEST_CASE("CallbackParser") {
 
   const std::string output = trim(oss.str());
   REQUIRE(match == output);
-}
\ No newline at end of file
+}
+
+TEST_CASE("StreamingCallbackParser") {
+
+  const std::string match = loadTestFile("SimpleCallbackParser.txt");
+
+  std::ostringstream oss;
+
+  Fountain::CallbackParser fp;
+  logCallbacks(fp, oss);
+
+  fp.streaming = true;
+
+  // Nothing is kept beyond the last element
+  size_t mostElements = 0;
+  auto addText = [&](const std::string &text) {
+    size_t start = 0;
+    while (start < text.size()) {
+      size_t end = std::min(text.find('\n', start), text.size());
+      fp.addLine(std::string_view(text).substr(start, end - start));
+      mostElements =
+          std::max(mostElements, fp.getScript()->getElements().size());
+      REQUIRE(fp.getScript()->getNotes().empty());
+      start = end + 1;
+    }
+    fp.finalizeParsing();
+  };
+
+  addText(loadTestFile("TitlePage.fountain"));
+  addText(loadTestFile("Sections.fountain"));
+  addText(loadTestFile("Character.fountain"));
+  addText(loadTestFile("Dialogue.fountain"));
+
+  REQUIRE(match == trim(oss.str()));
+  REQUIRE(mostElements == 1);
+
+  // Notes keep counting up once the earlier ones are gone
+  oss.str("");
+  addText("Before[[one]]\n\nAfter[[two]]\n");
+  REQUIRE(oss.str() == "ACTION: text:Before[[0]]\nACTION: text:After[[1]]\n");
+}
+
+namespace {
+
+std::string asNull(std::optional<std::string_view> value) {
+  return std::string(value.value_or("null"));
+}
+
+// Logs the same as logCallbacks()
+struct LogHandler {
+  std::ostringstream oss;
+
+  void onTitlePage(const std::vector<std::shared_ptr<TitleEntry>> &entries) {
+    oss << "TITLEPAGE:";
+    for (const auto &entry : entries)
+      oss << " " << entry->getKey() << ":" << entry->getTextRaw();
+    oss << std::endl;
+  }
+
+  void onDialogue(std::string_view character,
+                  std::optional<std::string_view> extension,
+                  std::optional<std::string_view> parenthetical,
+                  std::string_view line, bool isDualDialogue) {
+    oss << "DIALOGUE:"
+        << " character:" << character << " extension:" << asNull(extension)
+        << " parenthetical:" << asNull(parenthetical) << " line:" << line
+        << " dual:" << asBool(isDualDialogue) << std::endl;
+  }
+
+  void onAction(std::string_view text) {
+    oss << "ACTION: text:" << text << std::endl;
+  }
+
+  void onSceneHeading(std::string_view text,
+                      std::optional<std::string_view> sceneNum) {
+    oss << "HEADING: text:" << text << " sceneNum:" << asNull(sceneNum)
+        << std::endl;
+  }
+
+  void onLyrics(std::string_view text) {
+    oss << "LYRICS: text:" << text << std::endl;
+  }
+
+  void onTransition(std::string_view text) {
+    oss << "TRANSITION: text:" << text << std::endl;
+  }
+
+  void onSection(std::string_view text, int level) {
+    oss << "SECTION: level:" << level << " text:" << text << std::endl;
+  }
+
+  void onSynopsis(std::string_view text) {
+    oss << "SYNOPSIS: text:" << text << std::endl;
+  }
+
+  void onPageBreak() { oss << "PAGEBREAK" << std::endl; }
+};
+
+struct DialogueCounter {
+  int count = 0;
+
+  void onDialogue(std::string_view, std::optional<std::string_view>,
+                  std::optional<std::string_view>, std::string_view, bool) {
+    count++;
+  }
+};
+
+} // namespace
+
+TEST_CASE("BasicCallbackParser") {
+
+  const std::string match = loadTestFile("SimpleCallbackParser.txt");
+
+  for (bool streaming : {false, true}) {
+    Fountain::BasicCallbackParser<LogHandler> fp;
+    fp.streaming = streaming;
+
+    fp.addText(loadTestFile("TitlePage.fountain"));
+    fp.addText(loadTestFile("Sections.fountain"));
+    fp.addText(loadTestFile("Character.fountain"));
+    fp.addText(loadTestFile("Dialogue.fountain"));
+
+    REQUIRE(match == trim(fp.handler.oss.str()));
+  }
+
+  // Handlers only need the events they use
+  Fountain::BasicCallbackParser<DialogueCounter> counter;
+  counter.addText(loadTestFile("Dialogue.fountain"));
+
+  int dialogueCount = 0;
+  Fountain::CallbackParser fp;
+  fp.onDialogue = [&](const std::string &, const std::optional<std::string>,
+                      const std::optional<std::string>, const std::string &,
+                      const bool) { dialogueCount++; };
+  fp.addText(loadTestFile("Dialogue.fountain"));
+
+  REQUIRE(dialogueCount > 0);
+  REQUIRE(counter.handler.count == dialogueCount);
+}
+
+TEST_CASE("CallbackParserParallel") {
+  // Long enough to be split into chunks, which would skip the callbacks
+  std::string source;
+  for (int i = 0; i < 100; i++)
+    source += "INT. HOUSE - DAY\n\n" + loadTestFile("Dialogue.fountain") +
+              "\n\n";
+
+  std::ostringstream sequentialLog;
+  Fountain::CallbackParser sequential;
+  logCallbacks(sequential, sequentialLog);
+  sequential.addText(source);
+
+  std::ostringstream parallelLog;
+  Fountain::CallbackParser parallel;
+  logCallbacks(parallel, parallelLog);
+  parallel.addTextParallel(source, 4);
+  REQUIRE(parallelLog.str() == sequentialLog.str());
+
+  Fountain::BasicCallbackParser<LogHandler> basic;
+  basic.addTextParallel(source, 4);
+  REQUIRE(basic.handler.oss.str() == sequentialLog.str());
+}
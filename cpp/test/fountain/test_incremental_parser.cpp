@@ -0,0 +1,243 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "../catch_amalgamated.hpp"
+#include "../test_utils.h"
+#include "screenplay_tools/fountain/incremental_parser.h"
+#include <algorithm>
+#include <random>
+
+using namespace ScreenplayTools;
+
+namespace {
+
+std::vector<std::string> splitLines(const std::string &text) {
+  std::vector<std::string> lines;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    if (end == std::string::npos)
+      end = text.size();
+    lines.push_back(text.substr(start, end - start));
+    start = end + 1;
+  }
+  return lines;
+}
+
+std::vector<std::string> linesOf(const Fountain::IncrementalParser &ip) {
+  std::vector<std::string> lines;
+  for (size_t line = 0; line < ip.getLineCount(); line++)
+    lines.push_back(ip.getLine(line));
+  return lines;
+}
+
+// Names in a table that are still in use, in order. An edit leaves a freed id
+// reading as an empty name.
+std::vector<std::string> liveNames(const std::vector<std::string> &names) {
+  std::vector<std::string> live;
+  for (const auto &name : names) {
+    if (!name.empty())
+      live.push_back(name);
+  }
+  std::sort(live.begin(), live.end());
+  return live;
+}
+
+// Everything a parse produces, indexes included. Tags and characters are
+// described by name, as an edit keeps their ids where a fresh parse would
+// number them afresh.
+std::string describe(const Script &script) {
+  std::string result = script.dump();
+  for (const auto &name : liveNames(script.getTagNames())) {
+    result += name + ":";
+    for (const auto &element : script.getElementsWithTag(name))
+      result += " " + element->getTextRaw();
+    result += "\n";
+  }
+  for (const auto &note : script.getNotes())
+    result += note->getTextRaw() + "\n";
+  for (const auto &boneyard : script.getBoneyards())
+    result += boneyard->getTextRaw() + "\n";
+  for (const auto &name : liveNames(script.getCharacterNames()))
+    result += name + " ";
+  result += "\n";
+  for (const auto &element : script.getElements()) {
+    if (element->getType() != ElementType::CHARACTER)
+      continue;
+    const auto &character = static_cast<const Character &>(*element);
+    CharacterId id = character.getCharacterId();
+    result += script.getCharacterName(id) + ":";
+    for (const auto &dialogue : script.getDialogueFor(id))
+      result += " " + dialogue->getTextRaw();
+    result += "\n";
+  }
+  const auto &elements = script.getElements();
+  for (const auto &scene : script.getScenes()) {
+    result += std::to_string(elements.positionOf(*scene.heading)) + "-" +
+              std::to_string(elements.positionOf(*scene.last));
+    for (const Element *outlined : scene.outline)
+      result += " " + std::to_string(elements.positionOf(*outlined));
+    result += "\n";
+  }
+  return result;
+}
+
+std::string parseFully(const std::vector<std::string> &lines, bool merge,
+                       bool tags) {
+  Fountain::Parser fp;
+  fp.mergeActions = merge;
+  fp.mergeDialogue = merge;
+  fp.useTags = tags;
+  fp.addLines(lines);
+  return describe(*fp.getScript());
+}
+
+} // namespace
+
+TEST_CASE("IncrementalParser") {
+
+  std::string source;
+  for (const char *file :
+       {"TitlePage.fountain", "Scratch.fountain", "Boneyards.fountain",
+        "Notes.fountain", "Dialogue.fountain", "Action.fountain",
+        "Tags.fountain", "Character.fountain", "LineBreaks.fountain",
+        "Sections.fountain"}) {
+    source += loadTestFile(file) + "\n";
+  }
+  const std::vector<std::string> corpus = splitLines(source);
+
+  SECTION("Edits match a full parse") {
+    for (bool merge : {true, false}) {
+      Fountain::IncrementalParser ip;
+      ip.mergeActions = merge;
+      ip.mergeDialogue = merge;
+      ip.useTags = true;
+      ip.checkpointInterval = 4;
+      ip.setText(source);
+      REQUIRE(describe(*ip.getScript()) ==
+              parseFully(linesOf(ip), merge, true));
+
+      std::mt19937 random(1234);
+      for (int edit = 0; edit < 60; edit++) {
+        const size_t lineCount = ip.getLineCount();
+        const size_t first = random() % (lineCount + 1);
+        const size_t remove = random() % 4;
+        std::vector<std::string> lines(random() % 4);
+        for (auto &line : lines)
+          line = corpus[random() % corpus.size()];
+
+        ip.replaceLines(first, remove, lines);
+        REQUIRE(describe(*ip.getScript()) ==
+                parseFully(linesOf(ip), merge, true));
+      }
+    }
+  }
+
+  SECTION("Tables only hold what's still in the script") {
+    Fountain::IncrementalParser ip;
+    ip.setText("INT. HOUSE\n\nBOB\nHi.\n");
+    for (const char *name : {"BOBB", "BOBBY", "ALICE"})
+      ip.replaceLines(2, 1, {name});
+
+    // Freed ids are handed out again, so the table doesn't grow either
+    const Script &script = *ip.getScript();
+    REQUIRE(liveNames(script.getCharacterNames()) ==
+            std::vector<std::string>{"ALICE"});
+    REQUIRE(script.getCharacterNames().size() <= 2);
+    REQUIRE_FALSE(script.findCharacter("BOB"));
+    const auto &alice =
+        static_cast<const Character &>(*script.getElements()[1]);
+    REQUIRE(script.findCharacter("ALICE") == alice.getCharacterId());
+    REQUIRE(describe(script) == parseFully(linesOf(ip), true, false));
+  }
+
+  SECTION("Characters keep their ids through edits") {
+    Fountain::IncrementalParser ip;
+    ip.setText("INT. HOUSE\n\nBOB\nHi.\n\nALICE\nHey.\n\nBOB (V.O.)\nBye.\n");
+    const Script &script = *ip.getScript();
+    auto cueId = [&](size_t position) {
+      return static_cast<const Character &>(*script.getElements()[position])
+          .getCueId();
+    };
+    const CharacterId bob = *script.findCharacter("BOB");
+    const CharacterId alice = *script.findCharacter("ALICE");
+    const CueId bobVO = cueId(5);
+
+    // Drops BOB's first cue but not his character, as another cue has it
+    ip.replaceLines(2, 3, {});
+    REQUIRE(script.findCharacter("BOB") == bob);
+    REQUIRE(script.findCharacter("ALICE") == alice);
+    REQUIRE(script.getDialogueFor(alice).size() == 1);
+    REQUIRE(cueId(3) == bobVO);
+    REQUIRE(describe(script) == parseFully(linesOf(ip), true, false));
+  }
+
+  SECTION("Tag table only holds tags still in use") {
+    Fountain::IncrementalParser ip;
+    ip.useTags = true;
+    ip.setText("INT. HOUSE #old\n\nShe waits. #waiting\n");
+    ip.replaceLines(0, 1, {"INT. HOUSE"});
+    ip.replaceLines(2, 1, {"She leaves. #leaving"});
+
+    const Script &script = *ip.getScript();
+    REQUIRE(liveNames(script.getTagNames()) ==
+            std::vector<std::string>{"leaving"});
+    REQUIRE(script.getTagNames().size() <= 2);
+    REQUIRE(script.getTagNames(*script.getElements()[1]) ==
+            std::vector<std::string>{"leaving"});
+    REQUIRE_FALSE(script.findTag("waiting"));
+    REQUIRE(describe(script) == parseFully(linesOf(ip), true, true));
+  }
+
+  SECTION("Only re-parses around the edit") {
+    std::string longSource;
+    for (int i = 0; i < 50; i++)
+      longSource += loadTestFile("Scratch.fountain") + "\n";
+
+    Fountain::IncrementalParser ip;
+    ip.setText(longSource);
+    const auto untouched = ip.getScript()->getElements().front();
+
+    const size_t middle = ip.getLineCount() / 2;
+    const auto work =
+        ip.replaceLines(middle, 1, {"Somebody else says something."});
+
+    REQUIRE(work.lines < 2 * ip.checkpointInterval + 10);
+    REQUIRE(ip.getScript()->getElements().front() == untouched);
+    REQUIRE(describe(*ip.getScript()) ==
+            parseFully(linesOf(ip), true, false));
+  }
+
+  SECTION("Work per edit doesn't grow with the document") {
+    const std::string scratch = loadTestFile("Scratch.fountain") + "\n";
+    const size_t scratchLines = splitLines(scratch).size();
+
+    // Makes and undoes an edit on each line of the first copy, noting the
+    // lines re-parsed and elements looked at for each
+    auto editWork = [&](int copies) {
+      std::string text;
+      for (int i = 0; i < copies; i++)
+        text += scratch;
+
+      Fountain::IncrementalParser ip;
+      ip.setText(text);
+      std::vector<size_t> work;
+      for (size_t line = 0; line < scratchLines; line++) {
+        const std::string original = ip.getLine(line);
+        for (const std::string &replacement :
+             {std::string("Somebody else says something."), original}) {
+          const auto done = ip.replaceLines(line, 1, {replacement});
+          work.push_back(done.lines);
+          work.push_back(done.elements);
+        }
+      }
+      REQUIRE(describe(*ip.getScript()) ==
+              parseFully(linesOf(ip), true, false));
+      return work;
+    };
+
+    const auto work = editWork(20);
+    REQUIRE(editWork(40) == work);
+    REQUIRE(editWork(80) == work);
+  }
+}
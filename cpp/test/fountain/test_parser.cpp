@@ -77,6 +77,32 @@ TEST_CASE("Character") {
   REQUIRE(match == output);
 }
 
+TEST_CASE("Characters") {
+
+  Fountain::Parser fp;
+
+  fp.addText("STEEL\nOne.\n\nBOB (V.O.)\n(quietly)\nTwo.\n\nAction.\n\n"
+             "STEEL (V.O.)\nThree.\n\nBOB\nFour.\n");
+
+  const Script &script = *fp.getScript();
+  REQUIRE(script.getCharacterNames() ==
+          std::vector<std::string>{"STEEL", "BOB"});
+  REQUIRE_FALSE(script.findCharacter("MOM").has_value());
+
+  auto bob = script.getDialogueFor(*script.findCharacter("BOB"));
+  REQUIRE(bob.size() == 3);
+  REQUIRE(bob[0]->getType() == ElementType::PARENTHETICAL);
+  REQUIRE(bob[1]->getText() == "Two.");
+  REQUIRE(bob[2]->getText() == "Four.");
+
+  // Same character, different cue
+  const auto &elements = script.getElements();
+  const auto &steel = static_cast<const Character &>(*elements[0]);
+  const auto &steelVO = static_cast<const Character &>(*elements[6]);
+  REQUIRE(steel.getCharacterId() == steelVO.getCharacterId());
+  REQUIRE(steel.getCueId() != steelVO.getCueId());
+}
+
 TEST_CASE("DialogueMerged") {
 
   const std::string source = loadTestFile("Dialogue.fountain");
@@ -227,6 +253,37 @@ TEST_CASE("Sections") {
   REQUIRE(match == output);
 }
 
+TEST_CASE("Scenes") {
+  Fountain::Parser fp;
+
+  fp.addText(loadTestFile("Sections.fountain"));
+
+  const Script &script = *fp.getScript();
+  const auto &elements = script.getElements();
+  const auto &scenes = script.getScenes();
+  REQUIRE(scenes.size() == 3);
+
+  REQUIRE(scenes[0].heading->getText() == "INT. PALACE HALLWAY - NIGHT");
+  REQUIRE(elements.positionOf(*scenes[0].heading) == 1);
+  REQUIRE(elements.positionOf(*scenes[0].last) == 2);
+  REQUIRE(scenes[0].outline == std::vector<Element *>{elements[0]});
+
+  // Ends at the next section
+  REQUIRE(elements.positionOf(*scenes[1].last) == 3);
+  REQUIRE(script.findScene("1a") == &scenes[1]);
+  REQUIRE(script.findScene("2") == nullptr);
+
+  // Only the section it's under, with that section's synopsis
+  REQUIRE(scenes[2].outline ==
+          std::vector<Element *>{elements[12], elements[13]});
+  REQUIRE(scenes[2].last == elements.back());
+
+  REQUIRE(script.getSceneAt(0) == nullptr);
+  REQUIRE(script.getSceneAt(2) == &scenes[0]);
+  REQUIRE(script.getSceneAt(5) == nullptr);
+  REQUIRE(script.getSceneAt(16) == &scenes[2]);
+}
+
 TEST_CASE("UTF8") {
   const std::string source = loadTestFile("UTF8.fountain");
   const std::string match = loadTestFile("UTF8.txt");
@@ -251,4 +308,287 @@ TEST_CASE("Tags") {
   const std::string output = fp.getScript()->dump();
 
   REQUIRE(match == output);
-}
\ No newline at end of file
+
+  const Script &script = *fp.getScript();
+
+  auto taggy = script.getElementsWithTag("taggy");
+  REQUIRE(taggy.size() == 2);
+  REQUIRE(taggy[0]->getText() == "This is scene 1, we think!");
+  REQUIRE(taggy[1]->getText() == "ext. OLYMPIA CIRCUS - NIGHT");
+
+  // The last element is looked up separately from the index
+  auto bah = script.getElementsWithTag("bah");
+  REQUIRE(bah.size() == 1);
+  REQUIRE(bah[0] == script.getElements().back());
+
+  REQUIRE(script.getElementsWithTag("nosuchtag").empty());
+  REQUIRE(script.getTagName(*script.findTag("taggy")) == "taggy");
+
+  // Tags by name, for an element
+  REQUIRE(script.getTagNames(*bah[0]) == std::vector<std::string>{"bah"});
+  Script other;
+  Action action("Tagged by name");
+  other.appendTags(action, {"one", "two", "one"});
+  const Element *added = other.addElement(std::move(action));
+  REQUIRE(other.getTagNames(*added) ==
+          std::vector<std::string>{"one", "two"});
+  REQUIRE(other.getElementsWithTag("two").size() == 1);
+}
+
+TEST_CASE("TagsWithNotes") {
+  // Tags come off the line after its notes and boneyards have been cut out,
+  // so the element keeps their placeholders rather than the raw text
+  Fountain::Parser fp;
+  fp.useTags = true;
+  fp.addText("INT. HOUSE - DAY\n\n"
+             "She waits [[by the door]] in the /*old*/ hall. #late #hall\n");
+
+  const Script &script = *fp.getScript();
+  REQUIRE(script.getElements().size() == 2);
+  const Element &action = *script.getElements()[1];
+  REQUIRE(action.getTextRaw() == "She waits [[0]] in the /*0*/ hall.");
+  REQUIRE(action.getText() == "She waits  in the  hall.");
+  REQUIRE(action.getAnnotations().size() == 2);
+  REQUIRE(action.getTagIds().size() == 2);
+  REQUIRE(script.getTagName(action.getTagIds()[0]) == "late");
+  REQUIRE(script.getTagName(action.getTagIds()[1]) == "hall");
+  REQUIRE(script.getNotes().size() == 1);
+  REQUIRE(script.getNotes()[0]->getText() == "by the door");
+  REQUIRE(script.getBoneyards().size() == 1);
+  REQUIRE(script.getBoneyards()[0]->getText() == "old");
+}
+
+TEST_CASE("TagsMergedAway") {
+  // Merging dialogue drops the merged line's tags, so they leave the table
+  Fountain::Parser fp;
+  fp.useTags = true;
+  fp.addText("BOB\nHi. #hi\nThere. #there\n\nShe leaves. #leaving\n");
+
+  const Script &script = *fp.getScript();
+  REQUIRE(script.getTagNames() == std::vector<std::string>{"hi", "leaving"});
+  REQUIRE_FALSE(script.findTag("there").has_value());
+  REQUIRE(script.getElementsWithTag("leaving").size() == 1);
+}
+
+TEST_CASE("Visit") {
+  Fountain::Parser fp;
+
+  fp.addText(loadTestFile("Scratch.fountain"));
+
+  size_t characters = 0, headings = 0, others = 0;
+  auto count = overloaded{[&](const Character &) { characters++; },
+                          [&](const SceneHeading &) { headings++; },
+                          [&](const Element &) { others++; }};
+
+  const auto &elements = fp.getScript()->getElements();
+  for (const auto &element : elements)
+    visit(*element, count);
+
+  auto countType = [&](ElementType type) {
+    return static_cast<size_t>(std::count_if(
+        elements.begin(), elements.end(),
+        [type](const auto &element) { return element->getType() == type; }));
+  };
+  REQUIRE(characters == countType(ElementType::CHARACTER));
+  REQUIRE(headings == countType(ElementType::HEADING));
+  REQUIRE(characters + headings + others == elements.size());
+
+  // Visitors can return values, and see the element's own class
+  Section section("Act One", 2);
+  Element &element = section;
+  REQUIRE(visit(element, overloaded{[](Section &s) { return s.getLevel(); },
+                                    [](Element &) { return 0; }}) == 2);
+}
+
+TEST_CASE("ParseFile") {
+  const std::string match = loadTestFile("Scratch.txt");
+
+  Fountain::Parser fp;
+
+  fp.parseFile(testFilePath("Scratch.fountain"));
+
+  const std::string output = fp.getScript()->dump();
+
+  REQUIRE(match == output);
+
+  Fountain::Parser missing;
+  REQUIRE_THROWS_AS(missing.parseFile(testFilePath("Missing.fountain")),
+                    std::runtime_error);
+}
+
+TEST_CASE("ElementsLiveWithScript") {
+  std::shared_ptr<Script> script;
+  const Element *first = nullptr;
+
+  {
+    Fountain::Parser fp;
+    fp.addText(loadTestFile("Scratch.fountain"));
+    script = fp.getScript();
+    first = script->getElements().front();
+  }
+
+  REQUIRE(first->getType() == ElementType::HEADING);
+  REQUIRE(first->getText() == "INT. SCEHE 1 - DAY");
+}
+
+TEST_CASE("CleanText") {
+  Fountain::Parser fp;
+  fp.addText("Plain action.\nMore action.\n\nINT. HOUSE - DAY\n\n"
+             "Action with [[a note]].\nAnd another line.\n");
+
+  const auto &elements = fp.getScript()->getElements();
+  REQUIRE(elements.size() == 3);
+
+  REQUIRE(elements[0]->getText() == "Plain action.\nMore action.");
+  REQUIRE(&elements[0]->getText() == &elements[0]->getTextRaw());
+
+  REQUIRE(elements[2]->getTextRaw() == "Action with [[0]].\nAnd another line.");
+  REQUIRE(elements[2]->getText() == "Action with .\nAnd another line.");
+}
+
+TEST_CASE("Annotations") {
+  Fountain::Parser fp;
+  fp.addText("INT. HOUSE /*old*/ - DAY 10*/\n\n"
+             "Action[[first]] then [[second /*cut*/]].\n");
+
+  const auto &elements = fp.getScript()->getElements();
+  REQUIRE(elements.size() == 2);
+
+  // Only placeholders the parser made count, not text that looks like one
+  REQUIRE(elements[0]->getTextRaw() == "INT. HOUSE /*0*/ - DAY 10*/");
+  REQUIRE(elements[0]->getText() == "INT. HOUSE  - DAY 10*/");
+  REQUIRE(elements[0]->getAnnotations().size() == 1);
+
+  const auto &annotations = elements[1]->getAnnotations();
+  REQUIRE(annotations.size() == 2);
+  REQUIRE(annotations[0].type == ElementType::NOTE);
+  REQUIRE(annotations[0].offset == 6);
+  REQUIRE(annotations[0].length == 5);
+  REQUIRE(annotations[0].id == 0);
+  REQUIRE(annotations[1].offset == 17);
+  REQUIRE(annotations[1].id == 1);
+
+  const auto &note = fp.getScript()->getNotes()[1];
+  REQUIRE(note->getTextRaw() == "second /*1*/");
+  REQUIRE(note->getAnnotations().size() == 1);
+  REQUIRE(note->getAnnotations()[0].type == ElementType::BONEYARD);
+  REQUIRE(note->getAnnotations()[0].id == 1);
+}
+
+TEST_CASE("AddTextParallel") {
+  // Headings inside boneyards and notes mustn't be taken as places to split.
+  const std::string hidden = "/* Boneyard\n\nINT. HIDDEN - DAY\n\n*/\n\n"
+                             "[[Note\nINT. ALSO HIDDEN - DAY\n]]\n\n";
+
+  std::string source;
+  for (int i = 0; i < 12; i++) {
+    for (const char *file :
+         {"Scratch.fountain", "SceneHeading.fountain", "Boneyards.fountain",
+          "Notes.fountain", "Dialogue.fountain", "Tags.fountain",
+          "LineBreaks.fountain", "Sections.fountain"}) {
+      source += loadTestFile(file) + "\n" + hidden;
+    }
+  }
+
+  auto describe = [](const Script &script) {
+    std::string result = script.dump();
+    for (const auto &element : script.getElements()) {
+      for (TagId tag : element->getTagIds())
+        result += script.getTagName(tag) + " ";
+      result += "\n";
+    }
+    for (const auto &note : script.getNotes())
+      result += note->getTextRaw() + "\n";
+    for (const auto &boneyard : script.getBoneyards())
+      result += boneyard->getTextRaw() + "\n";
+    for (CharacterId id = 0; id < script.getCharacterNames().size(); id++)
+      result += std::to_string(script.getDialogueFor(id).size()) + "\n";
+    const auto &elements = script.getElements();
+    for (const auto &scene : script.getScenes())
+      result += std::to_string(elements.positionOf(*scene.heading)) + "-" +
+                std::to_string(elements.positionOf(*scene.last)) + " " +
+                std::to_string(scene.outline.size()) + "\n";
+    return result;
+  };
+
+  for (bool merge : {true, false}) {
+    for (bool tags : {true, false}) {
+      Fountain::Parser sequential;
+      sequential.mergeActions = sequential.mergeDialogue = merge;
+      sequential.useTags = tags;
+      sequential.addText(source);
+
+      Fountain::Parser parallel;
+      parallel.mergeActions = parallel.mergeDialogue = merge;
+      parallel.useTags = tags;
+      parallel.addTextParallel(source, 4);
+
+      REQUIRE(describe(*parallel.getScript()) ==
+              describe(*sequential.getScript()));
+    }
+  }
+}
+
+#ifdef SCREENPLAY_TOOLS_PARSE_STATS
+TEST_CASE("ParseStats") {
+  Fountain::Parser fp;
+  fp.addText("Title: Stats\n"
+             "\n"
+             "INT. HOUSE - DAY\n"
+             "\n"
+             "BOB\n"
+             "Hello.\n"
+             "Still talking.\n"
+             "\n"
+             "CUT TO:\n"
+             "\n"
+             "He walks.\n"
+             "He runs.\n"
+             "\n"
+             "ALICE\n"
+             "\n");
+  const Fountain::ParseStats &stats = fp.stats;
+
+  REQUIRE(stats.lines == 15);
+  uint64_t hits = 0;
+  for (const auto &rule : stats.rules) {
+    REQUIRE(rule.hits <= rule.attempts);
+    hits += rule.hits;
+  }
+  REQUIRE(hits == stats.lines);
+
+  REQUIRE(stats[Fountain::ParseRule::Boneyard].attempts == 15);
+  REQUIRE(stats[Fountain::ParseRule::SceneHeading].hits == 1);
+  REQUIRE(stats[Fountain::ParseRule::Action].attempts ==
+          stats[Fountain::ParseRule::Action].hits);
+  REQUIRE(stats[Fountain::ParseRule::Action].nanoseconds > 0);
+
+  REQUIRE(stats.characters == 1);
+  REQUIRE(stats.charactersAsAction == 1);
+  REQUIRE(stats.transitions == 1);
+  REQUIRE(stats.transitionsAsAction == 0);
+  REQUIRE(stats.dialogueMerges == 1);
+  // ALICE turns out to be action, and joins the one before over the blank
+  REQUIRE(stats.actionMerges == 2);
+  REQUIRE(stats.paddingMerges == 1);
+
+  SECTION("A parallel parse counts the same") {
+    std::string source;
+    for (int i = 0; i < 300; i++)
+      source += "INT. HOUSE - DAY\n\nBOB\nHello.\n\nHe walks.\nHe runs.\n\n";
+
+    Fountain::Parser sequential;
+    sequential.addText(source);
+    Fountain::Parser parallel;
+    parallel.addTextParallel(source, 4);
+
+    REQUIRE(parallel.stats.lines == sequential.stats.lines);
+    for (size_t i = 0; i < parallel.stats.rules.size(); i++) {
+      REQUIRE(parallel.stats.rules[i].attempts ==
+              sequential.stats.rules[i].attempts);
+      REQUIRE(parallel.stats.rules[i].hits == sequential.stats.rules[i].hits);
+    }
+    REQUIRE(parallel.stats.actionMerges == sequential.stats.actionMerges);
+  }
+}
+#endif
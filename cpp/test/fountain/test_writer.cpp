@@ -3,8 +3,11 @@
 
 #include "../catch_amalgamated.hpp"
 #include "../test_utils.h"
+#include "corpus.h"
 #include "screenplay_tools/fountain/parser.h"
 #include "screenplay_tools/fountain/writer.h"
+#include <cstdio>
+#include <sstream>
 
 using namespace ScreenplayTools;
 
@@ -66,4 +69,78 @@ TEST_CASE("Append") {
 
   // std::cout << output << std::endl;
   REQUIRE(match == output);
-}
\ No newline at end of file
+}
+
+TEST_CASE("NotesWriter") {
+
+  Fountain::Parser fp;
+
+  fp.addText("JACK\nHello[[This needs work.\nOr coffee.]] there.\n\n"
+             "Gone. /*Cut [[this]]*/ Back.\n");
+
+  Fountain::Writer fw;
+  const std::string output = fw.write(*fp.getScript());
+
+  // Notes and boneyards go back as they were, without the dialogue's tabs
+  REQUIRE(output == "\t\t\tJACK\n\tHello[[This needs work.\nOr coffee.]] "
+                    "there.\n\nGone. /*Cut [[this]]*/ Back.");
+}
+
+TEST_CASE("WriterSinks") {
+  // Long enough to go to the sink in several blocks
+  CorpusOptions options;
+  options.noteChance = 30;
+  options.boneyardChance = 30;
+  const Corpus corpus = generateCorpus(options);
+
+  Fountain::Parser fp;
+  fp.addText(corpus.fountain);
+  const Script &script = *fp.getScript();
+
+  Fountain::Writer fw;
+  const std::string match = fw.write(script);
+  REQUIRE(match.size() > 256 * 1024);
+
+  std::string buffer = "Before\n";
+  StringSink stringSink(buffer);
+  fw.write(script, stringSink);
+  REQUIRE(buffer == "Before\n" + match);
+
+  std::ostringstream stream;
+  StreamSink streamSink(stream);
+  fw.write(script, streamSink);
+  REQUIRE(stream.str() == match);
+
+  std::FILE *file = std::tmpfile();
+  REQUIRE(file != nullptr);
+  FileDescriptorSink fdSink(fileno(file));
+  fw.write(script, fdSink);
+  std::rewind(file);
+  std::string written(match.size() + 1, '\0');
+  written.resize(std::fread(written.data(), 1, written.size(), file));
+  std::fclose(file);
+  REQUIRE(written == match);
+}
+
+TEST_CASE("MeasuredWrite") {
+  CorpusOptions options;
+  options.lines = 2000;
+  options.noteChance = 30;
+  options.boneyardChance = 30;
+  Fountain::Parser fp;
+  fp.addText(loadTestFile("TitlePage.fountain"));
+  fp.addText(generateCorpus(options).fountain);
+  fp.addText(loadTestFile("UTF8.fountain"));
+  const Script &script = *fp.getScript();
+
+  Fountain::Writer fw;
+  const std::string match = fw.write(script);
+  REQUIRE(fw.measure(script) == match.size());
+
+  std::string buffer(match.size(), '\0');
+  REQUIRE(fw.write(script, buffer) == match.size());
+  REQUIRE(buffer == match);
+
+  buffer.pop_back();
+  REQUIRE_THROWS_AS(fw.write(script, buffer), std::length_error);
+}
@@ -0,0 +1,54 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "catch_amalgamated.hpp"
+#include "screenplay_tools/columnar_script.h"
+#include "screenplay_tools/fountain/parser.h"
+#include "test_utils.h"
+
+using namespace ScreenplayTools;
+
+TEST_CASE("ColumnarScript") {
+
+  Fountain::Parser fp;
+  fp.addText(loadTestFile("Character.fountain"));
+  fp.addText(loadTestFile("SceneHeading.fountain"));
+
+  const Script &script = *fp.getScript();
+  ColumnarScript columns(script);
+
+  REQUIRE(columns.size() == script.getElements().size());
+
+  for (size_t i = 0; i < columns.size(); i++) {
+    const auto &element = script.getElements()[i];
+    REQUIRE(columns.getType(i) == element->getType());
+    REQUIRE(columns.getText(i) == element->getText());
+  }
+
+  std::vector<size_t> steel = columns.getDialogueFor("STEEL");
+  REQUIRE(steel.size() == 5);
+  CHECK(columns.getText(steel[0]) == "The man’s a myth!");
+  CHECK(columns.getCharacterExtension(steel[3]) == "V.O.");
+  CHECK(columns.getDialogueFor("NOBODY").empty());
+
+  // Every cue with a name shares its id, which is handed out at its first cue
+  const uint32_t steelId = columns.findCharacterId("STEEL");
+  for (size_t i : steel)
+    CHECK(columns.getCharacterId(i) == steelId);
+  CHECK(columns.getCharacterId(0) == 0);
+  CHECK(columns.findCharacterId("NOBODY") == ColumnarScript::npos);
+
+  size_t dual = 0;
+  columns.forEachOfType(ElementType::CHARACTER, [&](size_t i) {
+    if (columns.isDualDialogue(i))
+      dual++;
+  });
+  CHECK(dual == 2);
+
+  std::vector<std::string> sceneNumbers;
+  columns.forEachOfType(ElementType::HEADING, [&](size_t i) {
+    if (auto number = columns.getSceneNumber(i))
+      sceneNumbers.emplace_back(*number);
+  });
+  CHECK(sceneNumbers == std::vector<std::string>{"3", "A3-1"});
+}
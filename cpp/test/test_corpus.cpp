@@ -0,0 +1,52 @@
+// This file is part of an MIT-licensed project: see LICENSE file or README.md
+// for details. Copyright (c) 2024 Ian Thomas
+
+#include "catch_amalgamated.hpp"
+#include "corpus.h"
+#include "screenplay_tools/fdx/writer.h"
+#include "screenplay_tools/fountain/parser.h"
+#include <algorithm>
+
+using namespace ScreenplayTools;
+
+TEST_CASE("Corpus") {
+
+  CorpusOptions options;
+  options.lines = 2000;
+
+  SECTION("The same seed gives the same corpus") {
+    const Corpus corpus = generateCorpus(options);
+    REQUIRE(corpus.fountain == generateCorpus(options).fountain);
+    REQUIRE(corpus.lines >= options.lines);
+    REQUIRE(static_cast<size_t>(std::count(corpus.fountain.begin(),
+                                            corpus.fountain.end(), '\n')) ==
+            corpus.lines);
+
+    options.seed++;
+    REQUIRE(corpus.fountain != generateCorpus(options).fountain);
+  }
+
+  SECTION("The FDX matches the Fountain") {
+    CorpusOptions busy = options;
+    busy.titlePage = false;
+    busy.dualDialogueWeight = 30;
+    busy.noteChance = 40;
+    busy.boneyardChance = 40;
+    busy.tagChance = 40;
+
+    CorpusOptions pathological = options;
+    pathological.longLineChance = 5;
+    pathological.longLineLength = 10000;
+    pathological.mergedActionChance = 10;
+    pathological.mergedActionLines = 300;
+
+    for (const CorpusOptions &each : {options, busy, pathological}) {
+      const Corpus corpus = generateCorpus(each);
+
+      Fountain::Parser parser;
+      parser.useTags = true;
+      parser.addText(corpus.fountain);
+      REQUIRE(FDX::Writer().Write(*parser.getScript()) == corpus.fdx);
+    }
+  }
+}
@@ -6,7 +6,8 @@
 
 #include <string>
 
-// Function declaration
+// Function declarations
+std::string testFilePath(const std::string& filepath);
 std::string loadTestFile(const std::string& filepath);
 
 #endif
\ No newline at end of file